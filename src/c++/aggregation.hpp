@@ -0,0 +1,587 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "binary-measurements.hpp"
+#include "paging.hpp"
+#include "registry.hpp"
+#include "run-stats.hpp"
+#include "scanning.hpp"
+#include "station-dictionary.hpp"
+#include "topology.hpp"
+
+
+namespace brc {
+    // Merges partial results pairwise in log2(N) rounds; the merges of each round run in parallel.
+    [[nodiscard]] inline Registry gather(std::vector<Registry> results) {
+        if (results.empty()) {
+            return Registry();
+        }
+
+        for (std::size_t stride = 1; stride < results.size(); stride *= 2) {
+            std::vector<std::thread> pool;
+            for (std::size_t i = 0; i + stride < results.size(); i += 2 * stride) {
+                pool.emplace_back([&lhs = results[i], &rhs = results[i + stride]] { lhs.merge(rhs); });
+            }
+
+            for (auto& thread : pool) {
+                thread.join();
+            }
+        }
+        return std::move(results.front());
+    }
+
+    // Combines partial results while the other workers are still busy. A worker that finishes takes whatever result is
+    // waiting, merges it into its own outside of the lock and tries again, so simultaneous finishers build a merge tree
+    // in parallel and nothing but the last merge is left once the final worker is done.
+    template <typename Partial>
+    class BasicReducer {
+    public:
+        void submit(Partial partial) {
+            while (true) {
+                std::unique_lock lock(mutex_);
+                if (!pending_) {
+                    pending_.emplace(std::move(partial));
+                    return;
+                }
+
+                Partial other = std::move(*pending_);
+                pending_.reset();
+                lock.unlock();
+
+                if (partial.size() < other.size()) {
+                    std::swap(partial, other);
+                }
+                partial.merge(other);
+            }
+        }
+
+        // Empty if nothing was submitted.
+        [[nodiscard]] std::optional<Partial> result() {
+            std::lock_guard lock(mutex_);
+            return std::exchange(pending_, std::nullopt);
+        }
+
+    private:
+        std::mutex             mutex_;
+        std::optional<Partial> pending_;
+    };
+
+    using Reducer = BasicReducer<Registry>;
+
+    inline void process_chunk(std::ifstream& source, std::size_t offset, std::size_t size, Registry& registry) {
+        source.clear();
+        source.seekg(offset);
+
+        std::string line;
+        std::size_t bytes_remains = size;
+        while ((bytes_remains != 0) && std::getline(source, line)) {
+            const std::size_t delimiter_pos = line.find(';');
+
+            const auto station     = std::string_view{line.data(), delimiter_pos};
+            const auto temperature = parse_temperature({line.data() + delimiter_pos + 1});
+            registry.add(station, temperature);
+
+            bytes_remains -= std::min(bytes_remains, line.size() + 1);  // the line and its new line character
+        }
+    }
+
+    // `Table` is a `Registry` or anything else with its `add(station, hash, temperature)`, e.g. a `DenseTable`.
+    template <typename Table>
+    void process_chunk(std::string_view chunk, Table& table) {
+        const char*       cursor = chunk.data();
+        const char* const end    = cursor + chunk.size();
+        while (cursor < end) {
+            const auto [delimiter, hash] = Registry::hasher_type::scan(cursor, end);
+
+            const auto station     = std::string_view{cursor, delimiter};
+            const auto temperature = decode_temperature(load_word(delimiter + 1, end));
+            table.add(station, hash, temperature.value);
+
+            cursor = delimiter + temperature.length + 2;  // skip the delimiter and the line break
+        }
+    }
+
+    // The same loops as above with their phases timed for `--stats`; only called when the instrumentation is compiled in.
+    inline void process_chunk(
+        std::ifstream& source, std::size_t offset, std::size_t size, Registry& registry, WorkerStats& stats
+    ) {
+        source.clear();
+        source.seekg(offset);
+
+        std::string line;
+        std::size_t bytes_remains = size;
+        while (bytes_remains != 0) {
+            PhaseTimer timer(stats);
+            if (!std::getline(source, line)) {
+                break;
+            }
+            const std::size_t delimiter_pos = line.find(';');
+            timer.lap(Phase::scan);
+
+            const auto station     = std::string_view{line.data(), delimiter_pos};
+            const auto temperature = parse_temperature({line.data() + delimiter_pos + 1});
+            timer.lap(Phase::parse);
+
+            registry.add(station, temperature);
+            timer.lap(Phase::lookup);
+
+            bytes_remains -= std::min(bytes_remains, line.size() + 1);
+            timer.commit();
+        }
+        stats.segments++;
+        stats.bytes += size - bytes_remains;
+    }
+
+    template <typename Table>
+    void process_chunk(std::string_view chunk, Table& table, WorkerStats& stats) {
+        const char*       cursor = chunk.data();
+        const char* const end    = cursor + chunk.size();
+        while (cursor < end) {
+            PhaseTimer timer(stats);
+            const auto [delimiter, hash] = Registry::hasher_type::scan(cursor, end);
+            timer.lap(Phase::scan);
+
+            const auto station     = std::string_view{cursor, delimiter};
+            const auto temperature = decode_temperature(load_word(delimiter + 1, end));
+            timer.lap(Phase::parse);
+
+            table.add(station, hash, temperature.value);
+            timer.lap(Phase::lookup);
+
+            cursor = delimiter + temperature.length + 2;
+            timer.commit();
+        }
+        stats.segments++;
+        stats.bytes += chunk.size();
+    }
+
+    [[nodiscard]] inline std::size_t get_file_size(std::ifstream& file) {
+        const auto original_pos = file.tellg();
+
+        file.seekg(0, std::ios::end);
+        const auto file_size = file.tellg();
+        file.seekg(original_pos);
+
+        return file_size;
+    }
+
+    [[nodiscard]] inline std::size_t seek_to(std::ifstream& file, std::size_t offset, char target) {
+        file.clear();
+        file.seekg(offset);
+        char symbol = 0;
+        while (file.get(symbol)) {
+            if (symbol == target) {
+                return ++offset;
+            }
+            offset++;
+        }
+        file.clear();
+        return offset;
+    }
+
+    constexpr std::size_t DEFAULT_SEGMENT_SIZE_MB = 8;
+
+    struct Segment {
+        std::size_t offset = 0;
+        std::size_t size   = 0;
+    };
+
+    // Hands newline-aligned segments out in file order: a worker claims the next one as soon as it is done with the
+    // previous, so a slow or descheduled core only holds back a single segment instead of a whole static slice.
+    class SegmentQueue {
+    public:
+        explicit SegmentQueue(std::vector<Segment> segments)
+            : segments_(std::move(segments)) {}
+
+        [[nodiscard]] std::optional<Segment> next() {
+            const auto index = next_.fetch_add(1, std::memory_order_relaxed);
+            if (index >= segments_.size()) {
+                return std::nullopt;
+            }
+            return segments_[index];
+        }
+
+    private:
+        std::vector<Segment>     segments_;
+        std::atomic<std::size_t> next_ = 0;
+    };
+
+    // Gives every NUMA node a contiguous share of the segments. Workers drain their own node's share first, so the pages
+    // they fault in are placed on their node, and only then help with the other shares.
+    class NodeSegmentQueue {
+    public:
+        NodeSegmentQueue(const std::vector<Segment>& segments, std::size_t node_count) {
+            node_count = std::max<std::size_t>(node_count, 1);
+            for (std::size_t node = 0; node != node_count; ++node) {
+                const auto first = segments.begin() + static_cast<std::ptrdiff_t>(node * segments.size() / node_count);
+                const auto last  = segments.begin() + static_cast<std::ptrdiff_t>((node + 1) * segments.size() / node_count);
+                queues_.emplace_back(std::vector<Segment>(first, last));
+            }
+        }
+
+        [[nodiscard]] std::optional<Segment> next(std::size_t node) {
+            for (std::size_t i = 0; i != queues_.size(); ++i) {
+                if (const auto segment = queues_[(node + i) % queues_.size()].next()) {
+                    return segment;
+                }
+            }
+            return std::nullopt;
+        }
+
+    private:
+        std::deque<SegmentQueue> queues_;
+    };
+
+    [[nodiscard]] inline std::vector<Segment> split_segments(std::ifstream& source, std::size_t segment_size) {
+        const auto file_size = get_file_size(source);
+
+        std::vector<Segment> segments;
+        for (std::size_t start = 0; start < file_size;) {
+            const auto end = seek_to(source, std::min(file_size, start + segment_size), '\n');
+            segments.push_back({start, end - start});
+            start = end;
+        }
+        return segments;
+    }
+
+    [[nodiscard]] inline std::vector<Segment> split_segments(std::string_view source, std::size_t segment_size) {
+        const char* const end = source.data() + source.size();
+
+        std::vector<Segment> segments;
+        for (std::size_t start = 0; start < source.size();) {
+            const auto hint       = std::min(source.size(), start + segment_size);
+            const auto line_break = find_byte(source.data() + hint, end, '\n');
+            const auto stop       = (line_break == end) ? source.size() : line_break - source.data() + 1;
+
+            segments.push_back({start, static_cast<std::size_t>(stop - start)});
+            start = stop;
+        }
+        return segments;
+    }
+
+    // Runs `worker(partial, worker_stats)` on `cpu_count` threads, at least one, each with its own `make_partial()`, and
+    // merges their results. `worker_stats` is null unless `stats` is given and the instrumentation is compiled in.
+    //
+    // With a `placement`, every thread is pinned to its CPU before it makes its partial result, so the result is
+    // allocated on the thread's node, and the results are merged within each node before they cross to another one: the
+    // last worker of a node to finish hands the node's result on. A worker that also takes a `std::size_t` is told its
+    // node, e.g. to pick its share of a `NodeSegmentQueue`.
+    template <typename MakePartial, typename Worker>
+    [[nodiscard]] auto run_workers(
+        std::size_t      cpu_count,
+        MakePartial&&    make_partial,
+        Worker&&         worker,
+        RunStats*        stats     = nullptr,
+        const Placement* placement = nullptr
+    ) -> decltype(make_partial()) {
+        using Partial = decltype(make_partial());
+
+        cpu_count = std::max<std::size_t>(cpu_count, 1);
+
+        const auto node_count    = (placement != nullptr) ? std::max<std::size_t>(placement->node_count, 1) : 1;
+        auto       node_reducers = std::make_unique<BasicReducer<Partial>[]>(node_count);
+        auto       remaining     = std::make_unique<std::atomic<std::size_t>[]>(node_count);
+        for (std::size_t i = 0; i != cpu_count; ++i) {
+            remaining[(placement != nullptr) ? placement->nodes[i] : 0]++;
+        }
+        BasicReducer<Partial> reducer;
+
+        if (!STATS_SUPPORTED) {
+            stats = nullptr;
+        }
+        if (stats != nullptr) {
+            stats->workers.resize(cpu_count);
+        }
+
+        std::vector<std::thread> pool;
+        for (std::size_t i = 0; i != cpu_count; i++) {
+            WorkerStats* worker_stats = (stats != nullptr) ? &stats->workers[i] : nullptr;
+            pool.emplace_back([&, i, worker_stats] {
+                const auto node = (placement != nullptr) ? placement->nodes[i] : 0;
+                if (placement != nullptr && placement->cpus[i]) {
+                    pin_current_thread(*placement->cpus[i]);
+                }
+
+                Partial    partial = make_partial();
+                const auto work    = [&](WorkerStats* current_stats) {
+                    if constexpr (std::is_invocable_v<Worker&, Partial&, WorkerStats*, std::size_t>) {
+                        worker(partial, current_stats, node);
+                    } else {
+                        worker(partial, current_stats);
+                    }
+                };
+                const auto submit = [&] {
+                    node_reducers[node].submit(std::move(partial));
+                    if (--remaining[node] == 0) {
+                        if (auto node_result = node_reducers[node].result()) {
+                            reducer.submit(std::move(*node_result));
+                        }
+                    }
+                };
+
+                if (!STATS_SUPPORTED || worker_stats == nullptr) {
+                    work(nullptr);
+                    submit();
+                    return;
+                }
+
+                const auto started = StatsClock::now();
+                work(worker_stats);
+                worker_stats->finished = StatsClock::now();
+                worker_stats->busy     = worker_stats->finished - started;
+                worker_stats->table.record(partial);
+
+                submit();
+                worker_stats->merge = StatsClock::now() - worker_stats->finished;
+            });
+        }
+
+        for (auto& thread : pool) {
+            thread.join();
+        }
+
+        auto result = reducer.result();
+        if (STATS_SUPPORTED && stats != nullptr && !stats->workers.empty()) {
+            const auto last = std::max_element(
+                stats->workers.begin(),
+                stats->workers.end(),
+                [](const WorkerStats& lhs, const WorkerStats& rhs) { return lhs.finished < rhs.finished; }
+            );
+            stats->gather = StatsClock::now() - last->finished;
+        }
+        return result ? std::move(*result) : make_partial();
+    }
+
+    template <typename Worker>
+    [[nodiscard]] Registry run_workers(std::size_t cpu_count, Worker&& worker, RunStats* stats = nullptr) {
+        return run_workers(cpu_count, [] { return Registry(); }, std::forward<Worker>(worker), stats);
+    }
+
+    template <typename Source>
+    [[nodiscard]] std::vector<Segment> make_segments(Source& source, std::size_t segment_size, RunStats* stats) {
+        if (!STATS_SUPPORTED || stats == nullptr) {
+            return split_segments(source, segment_size);
+        }
+
+        const auto started  = StatsClock::now();
+        auto       segments = split_segments(source, segment_size);
+
+        stats->split = StatsClock::now() - started;
+        for (const auto& segment : segments) {
+            stats->segment_sizes.push_back(segment.size);
+        }
+        return segments;
+    }
+
+    template <typename Source>
+    [[nodiscard]] SegmentQueue make_segment_queue(Source& source, std::size_t segment_size, RunStats* stats) {
+        return SegmentQueue(make_segments(source, segment_size, stats));
+    }
+
+    [[nodiscard]] inline Registry process_measurements(
+        const std::filesystem::path& source_path, std::size_t cpu_count, std::size_t segment_size, RunStats* stats = nullptr
+    ) {
+        std::ifstream source(source_path, std::ios::binary);
+        SegmentQueue  queue = make_segment_queue(source, segment_size, stats);
+
+        const auto worker = [&](Registry& registry, WorkerStats* worker_stats) {
+            std::ifstream reader(source_path, std::ios::binary);
+            while (const auto segment = queue.next()) {
+                if (STATS_SUPPORTED && worker_stats != nullptr) {
+                    process_chunk(reader, segment->offset, segment->size, registry, *worker_stats);
+                } else {
+                    process_chunk(reader, segment->offset, segment->size, registry);
+                }
+            }
+        };
+        return run_workers(cpu_count, worker, stats);
+    }
+
+    // Aggregates the `segments` of `source`, newline-aligned and in any order, which need not cover all of it. Workers
+    // number the stations through one shared dictionary and keep their records in dense tables, so the partial results
+    // are merged element-wise and each name is hashed and compared only once more, when the final registry is built.
+    // With a `prefetch_distance`, a `Prefetcher` faults the source in that many bytes ahead of every worker. With a
+    // `placement`, the workers are pinned and each node reads its own contiguous share of the segments first.
+    [[nodiscard]] inline Registry process_segments(
+        std::string_view            source,
+        const std::vector<Segment>& segments,
+        std::size_t                 cpu_count,
+        RunStats*                   stats             = nullptr,
+        std::size_t                 prefetch_distance = 0,
+        const Placement*            placement         = nullptr
+    ) {
+        NodeSegmentQueue  queue(segments, (placement != nullptr) ? placement->node_count : 1);
+        StationDictionary dictionary;
+        Prefetcher        prefetcher(source, prefetch_distance, cpu_count);
+
+        const auto worker = [&](DenseTable& table, WorkerStats* worker_stats, std::size_t node) {
+            const auto process = [&](std::string_view chunk) {
+                if (STATS_SUPPORTED && worker_stats != nullptr) {
+                    process_chunk(chunk, table, *worker_stats);
+                } else {
+                    process_chunk(chunk, table);
+                }
+            };
+
+            Prefetcher::Cursor* cursor = prefetcher.enabled() ? &prefetcher.attach() : nullptr;
+            while (const auto segment = queue.next(node)) {
+                const auto chunk = source.substr(segment->offset, segment->size);
+                if (cursor == nullptr) {
+                    process(chunk);
+                    continue;
+                }
+
+                const auto pieces = process_prefetched(chunk, segment->offset, *cursor, process);
+                if (STATS_SUPPORTED && worker_stats != nullptr && pieces > 1) {
+                    worker_stats->segments -= pieces - 1;  // the pieces of a segment count as one
+                }
+            }
+        };
+        const auto table = run_workers(cpu_count, [&] { return DenseTable(dictionary); }, worker, stats, placement);
+
+        if (STATS_SUPPORTED && stats != nullptr) {
+            stats->dictionary.emplace().record(dictionary);
+        }
+
+        const auto started = StatsClock::now();
+        auto       result  = table.to_registry();
+        if (STATS_SUPPORTED && stats != nullptr) {
+            stats->gather += StatsClock::now() - started;
+        }
+        return result;
+    }
+
+    // Cuts all of `source` into segments of about `segment_size` bytes and aggregates them with `process_segments`.
+    [[nodiscard]] inline Registry process_measurements(
+        std::string_view source,
+        std::size_t      cpu_count,
+        std::size_t      segment_size,
+        RunStats*        stats             = nullptr,
+        std::size_t      prefetch_distance = 0,
+        const Placement* placement         = nullptr
+    ) {
+        const auto segments = make_segments(source, segment_size, stats);
+        return process_segments(source, segments, cpu_count, stats, prefetch_distance, placement);
+    }
+
+    // One worker's records of a binary file, indexed by station id, with room for the stations of the file's dictionary
+    // only. Rows whose id is past the dictionary all land on one extra record, which keeps the inner loop free of
+    // branches and still lets a malformed file be told apart.
+    class BinaryTable {
+    public:
+        explicit BinaryTable(std::size_t station_count)
+            : stats_(station_count + 1) {}
+
+        void add_block(const std::uint16_t* stations, const std::int16_t* temperatures, std::size_t size) {
+            const std::size_t unknown = stats_.size() - 1;
+            for (std::size_t i = 0; i != size; ++i) {
+                stats_[std::min<std::size_t>(stations[i], unknown)].add(temperatures[i]);
+            }
+        }
+
+        void merge(const BinaryTable& other) {
+            for (std::size_t id = 0; id != stats_.size(); ++id) {
+                stats_[id].merge(other.stats_[id]);
+            }
+        }
+
+        // Number of stations with records.
+        [[nodiscard]] std::size_t size() const {
+            const auto used =
+                std::count_if(stats_.begin(), stats_.end(), [](const Stats& stats) { return stats.count != 0; });
+            return static_cast<std::size_t>(used);
+        }
+
+        [[nodiscard]] std::size_t capacity() const {
+            return stats_.size();
+        }
+
+        // Whether a row had an id the dictionary does not have.
+        [[nodiscard]] bool has_unknown_ids() const {
+            return stats_.back().count != 0;
+        }
+
+        [[nodiscard]] const Stats& stats(std::size_t id) const {
+            return stats_[id];
+        }
+
+    private:
+        std::vector<Stats> stats_;
+    };
+
+    // Aggregates a binary file. Rows already carry station ids, so every worker accumulates whole blocks into a
+    // `BinaryTable`, with no parsing, hashing or key comparison, and the tables are added up element-wise as the workers
+    // finish, like the dense tables of text sources. Empty if a row's id is not in the dictionary.
+    [[nodiscard]] inline std::optional<Registry> process_binary(const BinaryLayout& layout, std::size_t cpu_count) {
+        const auto               station_count = layout.stations.size();
+        std::atomic<std::size_t> next_block    = 0;
+
+        const auto worker = [&](BinaryTable& table, WorkerStats*) {
+            for (auto block = next_block++; block < layout.block_count(); block = next_block++) {
+                table.add_block(layout.station_ids(block), layout.temperatures(block), layout.block_size(block));
+            }
+        };
+        const auto totals = run_workers(cpu_count, [&] { return BinaryTable(station_count); }, worker);
+        if (totals.has_unknown_ids()) {
+            return std::nullopt;
+        }
+
+        Registry registry(2 * station_count);
+        for (std::size_t id = 0; id != station_count; ++id) {
+            if (totals.stats(id).count != 0) {
+                registry.merge(layout.stations[id], totals.stats(id));
+            }
+        }
+        return registry;
+    }
+
+    // Rewrites a text source in the binary format, numbering the stations in order of first appearance.
+    [[nodiscard]] inline bool convert_to_binary(std::string_view source, const std::filesystem::path& target_path) {
+        BinaryWriter writer(target_path);
+        if (!writer.good()) {
+            return false;
+        }
+
+        std::unordered_map<std::string_view, std::uint16_t, StationHasher, std::equal_to<>> ids;
+        std::vector<std::string_view>                                                         stations;
+
+        const char*       cursor = source.data();
+        const char* const end    = cursor + source.size();
+        while (cursor < end) {
+            const char* delimiter   = find_byte(cursor, end, ';');
+            const auto  station     = std::string_view{cursor, delimiter};
+            const auto  temperature = decode_temperature(load_word(delimiter + 1, end));
+
+            const auto [it, inserted] = ids.try_emplace(station, static_cast<std::uint16_t>(stations.size()));
+            if (inserted) {
+                if (stations.size() == BINARY_MAX_STATIONS) {
+                    return false;
+                }
+                stations.push_back(station);
+            }
+            writer.append(it->second, static_cast<std::int16_t>(temperature.value));
+
+            cursor = delimiter + temperature.length + 2;
+        }
+
+        return writer.finish(stations);
+    }
+}  // namespace brc
@@ -1,269 +1,622 @@
 #include <algorithm>
+#include <chrono>
+#include <clocale>
+#include <cmath>
 #include <filesystem>
 #include <format>
 #include <fstream>
 #include <iostream>
+#include <optional>
 #include <string>
 #include <string_view>
+#include <system_error>
 #include <thread>
-#include <unordered_map>
+#include <tuple>
+#include <utility>
+#include <vector>
 
 #include <cxxopts.hpp>
 
-struct Stats {
-    std::int64_t min   = std::numeric_limits<std::int64_t>::max();
-    std::int64_t max   = std::numeric_limits<std::int64_t>::min();
-    std::int64_t sum   = 0.0;
-    std::size_t  count = 0;
+#if defined(_WIN32)
+    #include <fcntl.h>
+    #include <io.h>
+#endif
+
+#include "aggregation.hpp"
+#include "binary-measurements.hpp"
+#include "mapped-file.hpp"
+#include "paging.hpp"
+#include "percentiles.hpp"
+#include "pipeline.hpp"
+#include "query.hpp"
+#include "read-ahead.hpp"
+#include "registry.hpp"
+#include "run-stats.hpp"
+#include "sharding.hpp"
+#include "snapshot.hpp"
+#include "split-index.hpp"
+#include "streaming.hpp"
+#include "topology.hpp"
+
+using namespace brc;
 
-    Stats() = default;
-    Stats(std::int64_t temperature)
-        : min(temperature)
-        , max(temperature)
-        , sum(temperature)
-        , count(1) {}
+[[nodiscard]] std::string time_past_since(const std::chrono::system_clock::time_point& start_point) {
+    const auto current_time = std::chrono::system_clock::now();
+    auto       delta        = duration_cast<std::chrono::milliseconds>(current_time - start_point);
 
-    [[nodiscard]] double minimum() const {
-        return min * 0.1;
-    }
+    const auto minutes      = duration_cast<std::chrono::minutes>(delta);
+    const auto seconds      = duration_cast<std::chrono::seconds>(delta - minutes);
+    const auto milliseconds = duration_cast<std::chrono::milliseconds>(delta - minutes - seconds);
 
-    [[nodiscard]] double maximum() const {
-        return max * 0.1;
-    }
+    return std::format("{:02d}:{:02d}:{:03d}", minutes.count(), seconds.count(), milliseconds.count());
+}
 
-    [[nodiscard]] double mean() const {
-        if (count == 0) {
-            return 0.0;
-        }
+// Prints `min/mean/max` per station, followed by `/median/p95/p99` when `percentiles` are given. Stations are listed by
+// name, or only the `top` ones by rank when a ranking is given.
+void print_statistic(
+    const Registry&                                       registry,
+    const StationPercentiles*                             percentiles = nullptr,
+    const std::optional<std::pair<std::size_t, RankKey>>& top         = std::nullopt
+) {
+    using Item = std::pair<std::string_view, Stats>;
 
-        return sum / static_cast<double>(count) * 0.1;
+    std::vector<Item> items;
+    if (top) {
+        items = top_stations(registry, top->first, top->second);
+    } else {
+        items.assign(registry.begin(), registry.end());
+        std::sort(items.begin(), items.end(), [](const Item& lhs, const Item& rhs) { return lhs.first < rhs.first; });
     }
-};
-
-class StringHasher {
-public:
-    using hash_type      = std::size_t;
-    using is_transparent = void;
-
-    static constexpr hash_type FNV_offset_basis = 14695981039346656037ULL;
-    static constexpr hash_type FNV_prime        = 1099511628211ULL;
 
-    hash_type operator()(const char* str) const {
-        return fnv1a_hash(str);
+    std::string result;
+    for (const auto& [station, record] : items) {
+        result.append(std::format("{}={:.1f}/{:.1f}/{:.1f}", station, record.minimum(), record.mean(), record.maximum()));
+        if (percentiles != nullptr) {
+            const auto& extra = percentiles->at(std::string(station));
+            result.append(std::format("/{:.1f}/{:.1f}/{:.1f}", extra.median, extra.p95, extra.p99));
+        }
+        result.append(", ");
     }
+    result.resize(result.size() - std::min<std::size_t>(result.size(), 2));
 
-    hash_type operator()(std::string_view str) const {
-        return fnv1a_hash(str);
-    }
+    std::cout << std::format("{{{}}}\n", result);
+}
 
-    hash_type operator()(const std::string& str) const {
-        return fnv1a_hash(str);
-    }
+// `hardware_concurrency` may report 0 when it cannot tell; one worker is the least that aggregates anything.
+[[nodiscard]] std::size_t get_cpu_count() {
+    return std::max(std::thread::hardware_concurrency(), 1u);
+}
 
-private:
-    static hash_type fnv1a_hash(std::string_view str) {
-        hash_type hash = FNV_offset_basis;
-        for (const unsigned char c : str) {
-            hash ^= c;
-            hash *= FNV_prime;
-        }
-        return hash;
-    }
-};
+// `merge` subcommand: combines the partial results of a sharded job, pairwise and in parallel like the workers'. The
+// partials must be those of one job: all of its shards, each once, cut from sources of the same size, so that none is
+// missing or counted twice.
+int merge_partials(int argc, const char* argv[]) {
+    cxxopts::Options options("billion-record-challenge merge", "Combine partial results saved with --save-partial.");
+    options.add_options()
+        ("partials", "Partial result files", cxxopts::value<std::vector<std::string>>())
+        ("save-partial", "Save the combined result as a partial file instead of printing it", cxxopts::value<std::filesystem::path>())
+        ("help", "Print usage")
+    ;
+    options.parse_positional("partials");
 
-using Registry = std::unordered_map<std::string, Stats, StringHasher, std::equal_to<>>;
+    const auto args = options.parse(argc, argv);
+    if (args.count("help") || !args.count("partials")) {
+        std::cout << options.help() << std::endl;
+        return args.count("help") ? 0 : 1;
+    }
 
+    const auto start_point = std::chrono::system_clock::now();
 
-[[nodiscard]] std::int64_t parse_temperature(std::string_view bytes) {
-    switch (bytes.size()) {
-        case 5: {
-            // "-99.9"
-            return -100 * (bytes[1] - '0') - 10 * (bytes[2] - '0') - (bytes[4] - '0');
+    const auto&                  paths = args["partials"].as<std::vector<std::string>>();
+    std::vector<Registry>        partials;
+    std::vector<std::string>     shard_paths;
+    std::optional<PartialHeader> job;
+    for (const auto& path : paths) {
+        auto partial = load_partial(path);
+        if (!partial) {
+            std::cout << std::format("Failed to read the partial result {}\n", path);
+            return 1;
         }
 
-        case 4: {
-            if (bytes[0] == '-') {
-                // "-9.9"
-                return -10 * (bytes[1] - '0') - (bytes[3] - '0');
-            } else {
-                // "99.9"
-                return 100 * (bytes[0] - '0') + 10 * (bytes[1] - '0');
+        const auto& header = partial->header;
+        if (!job) {
+            if (header.shard.count != paths.size()) {
+                std::cout << std::format(
+                    "{} is one of {} shards, but {} partial results are given\n", path, header.shard.count, paths.size()
+                );
+                return 1;
             }
+            job = header;
+            shard_paths.resize(header.shard.count);
         }
-
-        default: {
-            // "9.9"
-            return 10 * (bytes[0] - '0') + (bytes[2] - '0');
+        if (header.shard.count != job->shard.count || header.source_size != job->source_size) {
+            std::cout << std::format("{} and {} are shards of different jobs\n", paths.front(), path);
+            return 1;
         }
+        if (!shard_paths[header.shard.index].empty()) {
+            std::cout << std::format(
+                "Shard {}/{} is given twice: {} and {}\n", header.shard.index, header.shard.count,
+                shard_paths[header.shard.index], path
+            );
+            return 1;
+        }
+        shard_paths[header.shard.index] = path;
+        partials.push_back(std::move(partial->registry));
+    }
+    const auto registry = gather(std::move(partials));
+
+    if (args.count("save-partial")) {
+        // the merged shards cover the whole source, so the result is the job's only shard
+        const auto& target_path = args["save-partial"].as<std::filesystem::path>();
+        if (!save_partial(target_path, PartialHeader{Shard{}, job->source_size}, registry)) {
+            std::cout << std::format("Failed to save the partial result to {}\n", target_path.string());
+            return 1;
+        }
+    } else {
+        print_statistic(registry);
     }
+
+    std::cout << std::format("The partial results were merged in {}\n", time_past_since(start_point));
+    return 0;
 }
 
-[[nodiscard]] std::string time_past_since(const std::chrono::system_clock::time_point& start_point) {
-    const auto current_time = std::chrono::system_clock::now();
-    auto       delta        = duration_cast<std::chrono::milliseconds>(current_time - start_point);
+int main(int argc, const char* argv[]) {
+    std::ios::sync_with_stdio(false);
+    std::setlocale(LC_ALL, "en_US.UTF-8");
 
-    const auto minutes      = duration_cast<std::chrono::minutes>(delta);
-    const auto seconds      = duration_cast<std::chrono::seconds>(delta - minutes);
-    const auto milliseconds = duration_cast<std::chrono::milliseconds>(delta - minutes - seconds);
+    if (argc > 1 && std::string_view(argv[1]) == "merge") {
+        return merge_partials(argc - 1, argv + 1);
+    }
 
-    return std::format("{:02d}:{:02d}:{:03d}", minutes.count(), seconds.count(), milliseconds.count());
-}
+    cxxopts::Options options("billion-record-challenge", "Read measurements from a CSV file and print statistics.");
+    options.add_options()
+        ("source", "Source file path, a directory of source files, or - for stdin", cxxopts::value<std::filesystem::path>())
+        ("pool-size", "Number of CPUs to use", cxxopts::value<std::size_t>()->default_value(std::to_string(get_cpu_count())))
+        ("segment-size", "Size of the work segments (or blocks, when streaming) handed out to the pool, in MiB", cxxopts::value<std::size_t>()->default_value(std::to_string(DEFAULT_SEGMENT_SIZE_MB)))
+        ("mmap", "Parse the source through a memory mapping", cxxopts::value<bool>()->default_value(MMAP_SUPPORTED ? "true" : "false"))
+        ("stream", "Read the source sequentially in bounded blocks, as is done for stdin and pipes", cxxopts::value<bool>()->default_value("false"))
+        ("madvise", "Access pattern to advise for the mapping: none, sequential or willneed", cxxopts::value<std::string>()->default_value("none"))
+        ("populate", "Fault the whole mapping in up front (MAP_POPULATE)", cxxopts::value<bool>()->default_value("false"))
+        ("huge-pages", "Align the mapping for transparent huge pages and ask for them", cxxopts::value<bool>()->default_value("false"))
+        ("prefetch", "Touch the mapped pages this many MiB ahead of every worker on a separate thread, 0 to disable", cxxopts::value<std::size_t>()->default_value("0"))
+        ("faults", "Report the page faults taken, per GiB of input", cxxopts::value<bool>()->default_value("false"))
+        ("read-ahead", "Read the source with a pool of reader threads and reusable buffers instead of mapping it", cxxopts::value<bool>()->default_value("false"))
+        ("readers", "Number of reader threads for --read-ahead, or of reader tasks for --pipeline", cxxopts::value<std::size_t>()->default_value(std::to_string(DEFAULT_READER_COUNT)))
+        ("direct-io", "Bypass the page cache (O_DIRECT) with --read-ahead or --pipeline", cxxopts::value<bool>()->default_value("false"))
+        ("pipeline", "Read, parse and aggregate the source in separate stages of coroutines on one thread pool, with bounded queues between them", cxxopts::value<bool>()->default_value("false"))
+        ("parsers", "Number of parser tasks for --pipeline, 0 for one per CPU", cxxopts::value<std::size_t>()->default_value("0"))
+        ("aggregators", "Number of aggregator tasks for --pipeline, 0 for one per CPU", cxxopts::value<std::size_t>()->default_value("0"))
+        ("batch-size", "Number of records the parsers hand to the aggregators at once with --pipeline", cxxopts::value<std::size_t>()->default_value(std::to_string(DEFAULT_BATCH_SIZE)))
+        ("pin", "Pin every worker thread to a CPU of its own", cxxopts::value<bool>()->default_value("false"))
+        ("numa", "Spread the workers over the NUMA nodes, read each node's share of the source on it and merge per node first; implies --pin", cxxopts::value<bool>()->default_value("false"))
+        ("incremental", "Only aggregate what was appended since the previous run, resuming from its snapshot", cxxopts::value<bool>()->default_value("false"))
+        ("snapshot", "Snapshot path for --incremental (defaults to <source>.snapshot)", cxxopts::value<std::filesystem::path>())
+        ("build-index", "Aggregate the source block by block and save the blocks with their summaries as a sidecar index", cxxopts::value<bool>()->default_value("false"))
+        ("use-index", "Take the split points and the summaries of unchanged blocks from the sidecar index", cxxopts::value<bool>()->default_value("false"))
+        ("index", "Sidecar index path for --build-index and --use-index (defaults to <source>.index)", cxxopts::value<std::filesystem::path>())
+        ("convert", "Convert the source into the binary format at the given path instead of aggregating it", cxxopts::value<std::filesystem::path>())
+        ("percentiles", "Also print the exact median, p95 and p99 of every station", cxxopts::value<bool>()->default_value("false"))
+        ("stations", "Only aggregate these stations, separated by ';'; a name ending in '*' is a prefix", cxxopts::value<std::string>())
+        ("min-temp", "Only aggregate readings of at least this temperature", cxxopts::value<double>())
+        ("max-temp", "Only aggregate readings of at most this temperature", cxxopts::value<double>())
+        ("top", "Only print the K stations ranking highest by --by", cxxopts::value<std::size_t>())
+        ("by", "Ranking of --top: mean, max, min or count", cxxopts::value<std::string>()->default_value("mean"))
+        ("shard", "Only aggregate the i-th of N newline-aligned shares of the source, or of the files of a directory, given as i/N", cxxopts::value<std::string>())
+        ("save-partial", "Save the result as a partial file for the merge subcommand instead of printing it", cxxopts::value<std::filesystem::path>())
+        ("stats", "Report per-worker phase timings, probe lengths and load balance on stderr (needs a BRC_STATS build)", cxxopts::value<bool>()->default_value("false"))
+        ("stats-format", "Format of the --stats report: text or json", cxxopts::value<std::string>()->default_value("text"))
+        ("help", "Print usage")
+    ;
+    options.parse_positional("source");
 
-[[nodiscard]] Registry gather(std::vector<Registry> results) {
-    Registry registry;
-    for (const auto& result : results) {
-        for (auto&& [station, data] : result) {
-            if (auto it = registry.find(station); it != registry.end()) {
-                auto& record = it->second;
-
-                record.min = std::min(record.min, data.min);
-                record.max = std::max(record.max, data.max);
-                record.sum += data.sum;
-                record.count += data.count;
-            } else {
-                registry.emplace(std::move(station), std::move(data));
-            }
-        }
+    const auto args = options.parse(argc, argv);
+    if (args.count("help")) {
+        std::cout << options.help() << std::endl;
+        return 0;
     }
-    return registry;
-}
 
-[[nodiscard]] Registry process_chunk(const std::filesystem::path& source_path, std::size_t offset, std::size_t size = -1) {
-    Registry registry;
+    // `-` is stdin; pipes and character devices cannot be mapped or seeked, so they are streamed as well
+    const auto& source_path = args["source"].as<std::filesystem::path>();
+    const auto  from_stdin  = source_path == "-";
+    const auto  streaming   = from_stdin || args["stream"].as<bool>() || std::filesystem::is_fifo(source_path)
+                          || std::filesystem::is_character_file(source_path);
+    const auto  directory   = !from_stdin && std::filesystem::is_directory(source_path);
+    const auto  readable    = streaming ? (from_stdin || std::filesystem::exists(source_path))
+                                        : (directory || std::filesystem::is_regular_file(source_path));
+    if (!readable) {
+        std::cout << std::format("File does not exist: {}\n", source_path.string());
+        return 1;
+    }
 
-    std::ifstream source(source_path, std::ios::binary);
-    source.seekg(offset);
+    const auto start_point = std::chrono::system_clock::now();
 
-    std::string line;
-    std::size_t bytes_remains = size;
-    while ((bytes_remains != 0) && std::getline(source, line)) {
-        const std::size_t delimiter_pos = line.find(';');
+    const auto cpu_count    = args["pool-size"].as<std::size_t>();
+    const auto segment_size = std::max<std::size_t>(args["segment-size"].as<std::size_t>(), 1) * 1024 * 1024;
+    const auto use_mmap     = args["mmap"].as<bool>();
+    if (cpu_count == 0) {
+        std::cout << "The pool size must be at least 1\n";
+        return 1;
+    }
+    if (use_mmap && !MMAP_SUPPORTED) {
+        std::cout << "Memory mapping is not supported on this platform\n";
+        return 1;
+    }
 
-        const auto station     = std::string_view{line.data(), delimiter_pos};
-        const auto temperature = parse_temperature({line.data() + delimiter_pos + 1});
-        if (auto it = registry.find(station); it != registry.end()) {
-            auto& record = it->second;
+    MapOptions  map_options;
+    const auto& advice = args["madvise"].as<std::string>();
+    if (advice == "sequential") {
+        map_options.advice = MapAdvice::sequential;
+    } else if (advice == "willneed") {
+        map_options.advice = MapAdvice::willneed;
+    } else if (advice != "none") {
+        std::cout << std::format("Unknown mapping advice: {}\n", advice);
+        return 1;
+    }
+    map_options.populate   = args["populate"].as<bool>();
+    map_options.huge_pages = args["huge-pages"].as<bool>();
 
-            record.min = std::min(record.min, temperature);
-            record.max = std::max(record.max, temperature);
-            record.sum += temperature;
-            record.count++;
-        } else {
-            registry.emplace(station, temperature);
-        }
+    const auto prefetch_distance = args["prefetch"].as<std::size_t>() * 1024 * 1024;
+    const auto report_faults     = args["faults"].as<bool>();
+    if (report_faults && !FAULT_COUNTS_SUPPORTED) {
+        std::cout << "Page fault counts are not available on this platform\n";
+        return 1;
+    }
+    const auto faults_before = page_faults();
 
-        bytes_remains -= line.size();
-        bytes_remains -= 1;  // new line character
+    const auto read_ahead = args["read-ahead"].as<bool>();
+    const auto pipelined  = args["pipeline"].as<bool>();
+    const auto direct_io  = args["direct-io"].as<bool>();
+    if (read_ahead && !READ_AHEAD_SUPPORTED) {
+        std::cout << "Read-ahead is not supported on this platform\n";
+        return 1;
+    }
+    if (pipelined && !PIPELINE_SUPPORTED) {
+        std::cout << "The pipeline is not supported on this platform\n";
+        return 1;
+    }
+    if (direct_io && (!(read_ahead || pipelined) || !DIRECT_IO_SUPPORTED)) {
+        std::cout << "Direct I/O needs --read-ahead or --pipeline on a platform with O_DIRECT\n";
+        return 1;
     }
 
-    return registry;
-}
+    const auto build_index = args["build-index"].as<bool>();
+    const auto use_index   = args["use-index"].as<bool>();
+    if ((build_index || use_index)
+        && (streaming || read_ahead || !use_mmap || args.count("convert") || args["incremental"].as<bool>()
+            || args["percentiles"].as<bool>() || args["stats"].as<bool>() || args["pin"].as<bool>()
+            || args["numa"].as<bool>())) {
+        std::cout << "The sidecar index applies to plain aggregation of a mapped text source\n";
+        return 1;
+    }
 
-[[nodiscard]] std::size_t get_file_size(std::ifstream& file) {
-    const auto original_pos = file.tellg();
+    auto index_path = source_path;
+    index_path += ".index";
+    if (args.count("index")) {
+        index_path = args["index"].as<std::filesystem::path>();
+    }
 
-    file.seekg(0, std::ios::end);
-    const auto file_size = file.tellg();
-    file.seekg(original_pos);
+    RowFilter  filter;
+    const auto filtered = args.count("stations") || args.count("min-temp") || args.count("max-temp");
+    if (args.count("stations") && !filter.set_stations(args["stations"].as<std::string>())) {
+        std::cout << "--stations needs at least one station name or prefix\n";
+        return 1;
+    }
+    if (args.count("min-temp")) {
+        filter.min_temperature = std::lround(args["min-temp"].as<double>() * 10.0);
+    }
+    if (args.count("max-temp")) {
+        filter.max_temperature = std::lround(args["max-temp"].as<double>() * 10.0);
+    }
+    if (filtered
+        && (streaming || read_ahead || !use_mmap || args.count("convert") || args["incremental"].as<bool>()
+            || args["percentiles"].as<bool>() || args["stats"].as<bool>() || args["pin"].as<bool>()
+            || args["numa"].as<bool>() || build_index || use_index || prefetch_distance != 0)) {
+        std::cout << "Station and temperature filters apply to plain aggregation of a mapped text source\n";
+        return 1;
+    }
 
-    return file_size;
-}
+    std::optional<std::pair<std::size_t, RankKey>> top;
+    if (args.count("top")) {
+        const auto& by = args["by"].as<std::string>();
+        if (by == "mean") {
+            top.emplace(args["top"].as<std::size_t>(), RankKey::mean);
+        } else if (by == "max") {
+            top.emplace(args["top"].as<std::size_t>(), RankKey::max);
+        } else if (by == "min") {
+            top.emplace(args["top"].as<std::size_t>(), RankKey::min);
+        } else if (by == "count") {
+            top.emplace(args["top"].as<std::size_t>(), RankKey::count);
+        } else {
+            std::cout << std::format("Unknown ranking: {}\n", by);
+            return 1;
+        }
+    }
 
-[[nodiscard]] std::size_t seek_to(std::ifstream& file, std::size_t offset, char target) {
-    file.seekg(offset);
-    char symbol = 0;
-    while (file.get(symbol)) {
-        if (symbol == target) {
-            return ++offset;
+    const auto numa = args["numa"].as<bool>();
+    const auto pin  = numa || args["pin"].as<bool>();
+    if (pin && !AFFINITY_SUPPORTED) {
+        std::cout << "Thread pinning is not supported on this platform\n";
+        return 1;
+    }
+    if (pin && (streaming || read_ahead || !use_mmap || args.count("convert") || args["incremental"].as<bool>()
+                || args["percentiles"].as<bool>())) {
+        std::cout << "Pinning and NUMA placement apply to plain aggregation of a mapped text source\n";
+        return 1;
+    }
+    std::optional<Shard> shard;
+    if (args.count("shard")) {
+        shard = parse_shard(args["shard"].as<std::string>());
+        if (!shard) {
+            std::cout << std::format("Malformed shard, expected i/N with i < N: {}\n", args["shard"].as<std::string>());
+            return 1;
         }
-        offset++;
     }
-    return file.tellg();
-}
+    if ((shard || directory)
+        && (streaming || read_ahead || !use_mmap || args.count("convert") || args["incremental"].as<bool>()
+            || args["percentiles"].as<bool>() || build_index || use_index)) {
+        std::cout << "Shards and directories are read through a memory mapping, without percentiles or indexes\n";
+        return 1;
+    }
+    if (directory && (filtered || pin || prefetch_distance != 0 || args["stats"].as<bool>())) {
+        std::cout << "Filters, pinning, prefetching and --stats apply to a single source file\n";
+        return 1;
+    }
 
-[[nodiscard]] Registry process_measurements(const std::filesystem::path& source_path, std::size_t cpu_count) {
-    std::vector<Registry> results(cpu_count);
+    if (pipelined
+        && (streaming || directory || read_ahead || args.count("convert") || args["incremental"].as<bool>()
+            || args["percentiles"].as<bool>() || build_index || use_index || filtered || pin || shard
+            || prefetch_distance != 0 || args["stats"].as<bool>())) {
+        std::cout << "The pipeline aggregates a whole regular file, with none of the other modes\n";
+        return 1;
+    }
 
-    std::ifstream source(source_path, std::ios::binary);
-    const auto    file_size       = get_file_size(source);
-    const auto    base_chunk_size = (file_size + cpu_count - 1) / cpu_count;
+    std::optional<std::filesystem::path> save_partial_path;
+    if (args.count("save-partial")) {
+        save_partial_path = args["save-partial"].as<std::filesystem::path>();
+    }
+    if (save_partial_path && (args.count("convert") || args["percentiles"].as<bool>())) {
+        std::cout << "Partial results hold neither conversions nor percentiles\n";
+        return 1;
+    }
 
-    std::vector<std::thread> pool;
+    const auto placement = pin ? std::optional(make_placement(read_cpu_topology(), cpu_count, numa)) : std::nullopt;
 
-    std::size_t start = 0;
-    for (auto i = 0u; i != cpu_count; i++) {
-        const auto hint = std::min(file_size, start + base_chunk_size);
-        const auto end  = seek_to(source, hint, '\n');
+    const auto  collect_stats = args["stats"].as<bool>();
+    const auto& stats_format  = args["stats-format"].as<std::string>();
+    if (collect_stats && !STATS_SUPPORTED) {
+        std::cout << "The instrumentation is not compiled in, configure with -DBRC_STATS=ON\n";
+        return 1;
+    }
+    if (stats_format != "text" && stats_format != "json") {
+        std::cout << std::format("Unknown stats format: {}\n", stats_format);
+        return 1;
+    }
 
-        pool.emplace_back([&result = results[i], &source_path, offset = start, size = end - start] {
-            result = process_chunk(source_path, offset, size);
-        });
+    RunStats  run_stats;
+    RunStats* stats = collect_stats ? &run_stats : nullptr;
 
-        start = end;
+    if (streaming) {
+        if (args.count("convert") || args["incremental"].as<bool>() || args["percentiles"].as<bool>() || read_ahead) {
+            std::cout << "Conversion, incremental runs, percentiles and read-ahead need a regular file\n";
+            return 1;
+        }
+    } else if (!use_mmap || read_ahead || pipelined) {
+        std::ifstream source(source_path, std::ios::binary);
+        std::string   header(sizeof(BinaryHeader), '\0');
+        source.read(header.data(), static_cast<std::streamsize>(header.size()));
+        if (is_binary_measurements({header.data(), static_cast<std::size_t>(source.gcount())})) {
+            std::cout << "Binary measurement files can only be read through a memory mapping\n";
+            return 1;
+        }
+        if (args.count("convert") || args["incremental"].as<bool>() || args["percentiles"].as<bool>()) {
+            std::cout << "Conversion, incremental runs and percentiles read the source through a memory mapping\n";
+            return 1;
+        }
     }
 
-    for (auto& thread : pool) {
-        thread.join();
-    }
+    Registry                          registry;
+    std::optional<StationPercentiles> percentiles;
+    if (directory) {
+#if defined(BRC_HAS_MMAP)
+        try {
+            auto result = process_directory(source_path, shard.value_or(Shard{}), cpu_count, segment_size, map_options);
+            if (!result) {
+                std::cout << std::format("Malformed binary file in {}\n", source_path.string());
+                return 1;
+            }
+            registry = std::move(*result);
+        } catch (const std::system_error& error) {
+            std::cout << std::format("{}\n", error.what());
+            return 1;
+        }
+#endif
+    } else if (streaming) {
+        std::optional<Registry> result;
+        if (from_stdin) {
+#if defined(_WIN32)
+            _setmode(_fileno(stdin), _O_BINARY);
+#endif
+            std::cin.tie(nullptr);
+            result = process_stream(std::cin, cpu_count, segment_size, stats);
+        } else {
+            std::ifstream source(source_path, std::ios::binary);
+            result = process_stream(source, cpu_count, segment_size, stats);
+        }
 
-    return gather(std::move(results));
-}
+        if (!result) {
+            std::cout << std::format("Failed to read {}, or a line is longer than a block\n", source_path.string());
+            return 1;
+        }
+        registry = std::move(*result);
+    } else if (pipelined) {
+#if defined(BRC_HAS_PREAD)
+        try {
+            Pipeline::Options pipeline_options;
+            pipeline_options.reader_count     = args["readers"].as<std::size_t>();
+            pipeline_options.parser_count     = args["parsers"].as<std::size_t>();
+            pipeline_options.aggregator_count = args["aggregators"].as<std::size_t>();
+            pipeline_options.block_size       = segment_size;
+            pipeline_options.batch_size       = args["batch-size"].as<std::size_t>();
+            pipeline_options.direct_io        = direct_io;
+
+            auto result = process_pipelined(source_path, cpu_count, pipeline_options);
+            if (!result) {
+                const auto limit = READ_AHEAD_ALIGNMENT;
+                std::cout << std::format("A line of {} is longer than {} bytes\n", source_path.string(), limit);
+                return 1;
+            }
+            registry = std::move(*result);
+        } catch (const std::system_error& error) {
+            std::cout << std::format("{}\n", error.what());
+            return 1;
+        }
+#endif
+    } else if (read_ahead) {
+#if defined(BRC_HAS_PREAD)
+        try {
+            const auto readers = args["readers"].as<std::size_t>();
+            auto       result  = process_read_ahead(source_path, cpu_count, segment_size, readers, direct_io, stats);
+            if (!result) {
+                const auto limit = READ_AHEAD_ALIGNMENT;
+                std::cout << std::format("A line of {} is longer than {} bytes\n", source_path.string(), limit);
+                return 1;
+            }
+            registry = std::move(*result);
+        } catch (const std::system_error& error) {
+            std::cout << std::format("{}\n", error.what());
+            return 1;
+        }
+#endif
+    } else if (use_mmap) {
+#if defined(BRC_HAS_MMAP)
+        try {
+            const MappedFile source(source_path, map_options);
+            const auto       layout = read_binary_layout(source.view());
+            const auto       text   = shard ? shard_view(source.view(), *shard) : source.view();
+
+            if (args.count("convert")) {
+                const auto& target_path = args["convert"].as<std::filesystem::path>();
+                if (layout || !convert_to_binary(source.view(), target_path)) {
+                    std::cout << std::format("Failed to convert {} into {}\n", source_path.string(), target_path.string());
+                    return 1;
+                }
+
+                std::cout << std::format("The file was converted in {}\n", time_past_since(start_point));
+                return 0;
+            }
 
-void print_statistic(const Registry& registry) {
-    using Item = Registry::const_iterator;
+            if (args["percentiles"].as<bool>() && (layout || args["incremental"].as<bool>())) {
+                std::cout << "Percentiles are only computed from a text source, without --incremental\n";
+                return 1;
+            }
 
-    std::vector<Item> items;
-    items.reserve(registry.size());
-    for (auto it = registry.cbegin(); it != registry.cend(); ++it) {
-        items.emplace_back(it);
-    }
-    std::sort(items.begin(), items.end(), [](const Item& lhs, const Item& rhs) { return lhs->first < rhs->first; });
+            if (layout && placement) {
+                std::cout << "Pinning and NUMA placement apply to plain aggregation of a mapped text source\n";
+                return 1;
+            }
+            if (layout && filtered) {
+                std::cout << "Station and temperature filters apply to plain aggregation of a mapped text source\n";
+                return 1;
+            }
+            if (layout && shard) {
+                std::cout << "Binary measurement files are not sharded, shard a directory of them instead\n";
+                return 1;
+            }
+            if (layout && (build_index || use_index)) {
+                std::cout << "The sidecar index applies to plain aggregation of a mapped text source\n";
+                return 1;
+            }
 
-    std::string result;
-    for (const auto& it : items) {
-        const auto& station = it->first;
-        const auto& record  = it->second;
-        result.append(std::format("{}={:.1f}/{:.1f}/{:.1f}, ", station, record.minimum(), record.mean(), record.maximum()));
+            if (layout) {
+                auto result = process_binary(*layout, cpu_count);
+                if (!result) {
+                    std::cout << std::format("Malformed binary file: {}\n", source_path.string());
+                    return 1;
+                }
+                registry = std::move(*result);
+            } else if (is_binary_measurements(source.view())) {
+                std::cout << std::format("Malformed binary file: {}\n", source_path.string());
+                return 1;
+            } else if (args["incremental"].as<bool>()) {
+                auto snapshot_path = source_path;
+                snapshot_path += ".snapshot";
+                if (args.count("snapshot")) {
+                    snapshot_path = args["snapshot"].as<std::filesystem::path>();
+                }
+                registry = process_incremental(source.view(), snapshot_path, cpu_count, segment_size);
+            } else if (filtered) {
+                registry = process_query(text, cpu_count, segment_size, filter);
+            } else if (build_index) {
+                SplitIndex index;
+                std::tie(registry, index) = build_split_index(source.view(), cpu_count, INDEX_BLOCK_SIZE_MB * 1024 * 1024);
+                if (!save_split_index(index_path, index)) {
+                    std::cout << std::format("Failed to save the index to {}\n", index_path.string());
+                    return 1;
+                }
+            } else if (use_index) {
+                const auto              index = load_split_index(index_path);
+                std::optional<Registry> result;
+                if (index) {
+                    result = process_indexed(source.view(), *index, cpu_count, segment_size);
+                }
+                if (!result) {
+                    std::cerr << "The index is missing or does not match the source, aggregating the whole file\n";
+                    result = process_measurements(source.view(), cpu_count, segment_size);
+                }
+                registry = std::move(*result);
+            } else if (args["percentiles"].as<bool>()) {
+                std::tie(registry, percentiles) = process_percentiles(source.view(), cpu_count, segment_size, stats);
+            } else {
+                registry = process_measurements(
+                    text, cpu_count, segment_size, stats, prefetch_distance, placement ? &*placement : nullptr
+                );
+            }
+        } catch (const std::system_error& error) {
+            std::cout << std::format("{}\n", error.what());
+            return 1;
+        }
+#endif
+    } else {
+        registry = process_measurements(source_path, cpu_count, segment_size, stats);
     }
-    result.resize(result.size() - 2);
 
-    std::cout << std::format("{{{}}}\n", result);
-}
+    const auto faults = page_faults();
 
-[[nodiscard]] std::size_t get_cpu_count() {
-    return std::thread::hardware_concurrency();
-}
+    if (save_partial_path) {
+        const PartialHeader header{shard.value_or(Shard{}), streaming ? 0 : source_size(source_path)};
+        if (!save_partial(*save_partial_path, header, registry)) {
+            std::cout << std::format("Failed to save the partial result to {}\n", save_partial_path->string());
+            return 1;
+        }
+        std::cout << std::format("The partial result was saved to {}\n", save_partial_path->string());
+    } else {
+        const auto print_start = StatsClock::now();
+        print_statistic(registry, percentiles ? &*percentiles : nullptr, top);
+        run_stats.print = StatsClock::now() - print_start;
+    }
 
-int main(int argc, const char* argv[]) {
-    std::ios::sync_with_stdio(false);
-    std::setlocale(LC_ALL, "en_US.UTF-8");
+    std::cout << std::format("The file was processed in {}\n", time_past_since(start_point));
 
-    cxxopts::Options options("billion-record-challenge", "Read measurements from a CSV file and print statistics.");
-    options.add_options()
-        ("source", "Source file path", cxxopts::value<std::filesystem::path>())
-        ("pool-size", "Number of CPUs to use", cxxopts::value<std::size_t>()->default_value(std::to_string(get_cpu_count())))
-        ("help", "Print usage")
-    ;
-    options.parse_positional("source");
+    if (report_faults) {
+        const auto minor = faults.minor - faults_before.minor;
+        const auto major = faults.major - faults_before.major;
+        const auto bytes = std::filesystem::is_regular_file(source_path) ? std::filesystem::file_size(source_path) : 0;
+        const auto gib   = static_cast<double>(bytes) / (1024.0 * 1024.0 * 1024.0);
 
-    const auto args = options.parse(argc, argv);
-    if (args.count("help")) {
-        std::cout << options.help() << std::endl;
-        return 0;
+        std::cout << std::format("Page faults: {} minor, {} major", minor, major);
+        if (bytes != 0) {
+            std::cout << std::format(", {:.0f} minor and {:.0f} major per GiB", minor / gib, major / gib);
+        }
+        std::cout << "\n";
     }
 
-    const auto& source_path = args["source"].as<std::filesystem::path>();
-    if (!std::filesystem::is_regular_file(source_path)) {
-        std::cout << std::format("File does not exist: {}\n", source_path.string());
-        return 1;
+    if (stats != nullptr) {
+        run_stats.total = std::chrono::system_clock::now() - start_point;
+        if (stats_format == "json") {
+            write_stats_json(std::cerr, run_stats);
+        } else {
+            write_stats_text(std::cerr, run_stats);
+        }
     }
-
-    const auto start_point = std::chrono::system_clock::now();
-
-    const auto cpu_count = args["pool-size"].as<std::size_t>();
-    const auto registry  = process_measurements(source_path, cpu_count);
-    print_statistic(registry);
-
-    std::cout << std::format("The file was processed in {}\n", time_past_since(start_point));
     return 0;
 }
@@ -0,0 +1,526 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "aggregation.hpp"
+#include "known-stations.hpp"
+#include "registry.hpp"
+#include "run-stats.hpp"
+#include "scanning.hpp"
+#include "station-dictionary.hpp"
+#include "weather-stations.hpp"
+
+
+using namespace brc;
+
+// Micro-benchmarks for the hot-path kernels of billion-record-challenge.
+//
+// Every benchmark performs a fixed batch of operations per repetition. The warmup repetitions are discarded, the wall
+// time of the others is recorded, and the report gives the median, p99 and best cost per operation together with the
+// throughput of the median repetition. Only the standard library is used, like in the rest of the project.
+
+struct Config {
+    std::size_t           repetitions = 50;
+    std::size_t           warmup      = 5;
+    std::size_t           rows        = 1'000'000;
+    std::size_t           stations    = 413;
+    std::size_t           partitions  = 16;
+    std::string           filter;
+    std::filesystem::path json_path;
+};
+
+struct Measurement {
+    std::string         name;
+    std::size_t         operations = 0;
+    std::size_t         bytes      = 0;
+    std::vector<double> seconds;  // one sample per repetition, sorted
+
+    [[nodiscard]] double percentile(double rank) const {
+        const auto index = static_cast<std::size_t>(std::ceil(rank * static_cast<double>(seconds.size())));
+        return seconds[std::clamp<std::size_t>(index, 1, seconds.size()) - 1];
+    }
+
+    [[nodiscard]] double ns_per_op(double sample) const {
+        return sample * 1e9 / static_cast<double>(std::max<std::size_t>(operations, 1));
+    }
+
+    [[nodiscard]] double bytes_per_second() const {
+        return static_cast<double>(bytes) / percentile(0.5);
+    }
+};
+
+// Keeps the compiler from dropping a computation whose result is otherwise unused.
+void keep(std::uint64_t value) {
+    static volatile std::uint64_t sink = 0;
+    sink                               = sink + value;
+}
+
+// Runs `body(setup())` for every repetition; only `body` is timed.
+template <typename Setup, typename Body>
+void measure(
+    const Config&             config,
+    std::vector<Measurement>& results,
+    std::string               name,
+    std::size_t               operations,
+    std::size_t               bytes,
+    Setup&&                   setup,
+    Body&&                    body
+) {
+    if (!config.filter.empty() && name.find(config.filter) == std::string::npos) {
+        return;
+    }
+
+    Measurement measurement{std::move(name), operations, bytes, {}};
+    for (std::size_t i = 0; i != config.warmup + config.repetitions; ++i) {
+        auto state = setup();
+
+        const auto start = std::chrono::steady_clock::now();
+        body(state);
+        const auto stop = std::chrono::steady_clock::now();
+
+        if (i >= config.warmup) {
+            measurement.seconds.push_back(std::chrono::duration<double>(stop - start).count());
+        }
+    }
+    std::sort(measurement.seconds.begin(), measurement.seconds.end());
+
+    std::cerr << std::format(
+        "{:<24} {:>10.2f} ns/op median\n", measurement.name, measurement.ns_per_op(measurement.percentile(0.5))
+    );
+    results.push_back(std::move(measurement));
+}
+
+template <typename Body>
+void measure(
+    const Config&             config,
+    std::vector<Measurement>& results,
+    std::string               name,
+    std::size_t               operations,
+    std::size_t               bytes,
+    Body&&                    body
+) {
+    measure(config, results, std::move(name), operations, bytes, [] { return 0; }, [&body](int) { body(); });
+}
+
+// Synthetic measurements: `stations` names of 3 to 24 letters and temperatures spread over [-99.9, 99.9].
+struct Dataset {
+    std::vector<std::string>      stations;
+    std::string                   text;
+    std::vector<std::string_view> names;         // the station of every row, pointing into `text`
+    std::vector<std::string_view> temperatures;  // the temperature field of every row, pointing into `text`
+};
+
+// Rows over the stations of KNOWN_STATIONS, with the same temperature spread as `make_dataset`.
+[[nodiscard]] std::string make_known_text(std::size_t rows) {
+    std::mt19937                               generator(42);
+    std::uniform_int_distribution<std::size_t> station(0, KNOWN_STATIONS.size() - 1);
+    std::uniform_int_distribution<int>         tenths(-999, 999);
+
+    std::string text;
+    for (std::size_t i = 0; i != rows; ++i) {
+        const auto value = tenths(generator);
+        text.append(KNOWN_STATIONS[station(generator)].name);
+        text.append(std::format(";{}{}.{}\n", value < 0 ? "-" : "", std::abs(value) / 10, std::abs(value) % 10));
+    }
+    return text;
+}
+
+[[nodiscard]] Dataset make_dataset(std::size_t rows, std::size_t station_count) {
+    std::mt19937                               generator(42);
+    std::uniform_int_distribution<std::size_t> length(3, 24);
+    std::uniform_int_distribution<int>         letter('a', 'z');
+    std::uniform_int_distribution<int>         tenths(-999, 999);
+
+    Dataset dataset;
+    while (dataset.stations.size() != station_count) {
+        std::string name(length(generator), ' ');
+        std::generate(name.begin(), name.end(), [&] { return static_cast<char>(letter(generator)); });
+        name.front() = static_cast<char>(name.front() - 'a' + 'A');
+        dataset.stations.push_back(std::move(name) + std::to_string(dataset.stations.size()));
+    }
+
+    std::uniform_int_distribution<std::size_t> station(0, station_count - 1);
+    for (std::size_t i = 0; i != rows; ++i) {
+        const auto value = tenths(generator);
+        dataset.text.append(dataset.stations[station(generator)]);
+        dataset.text.append(std::format(";{}{}.{}\n", value < 0 ? "-" : "", std::abs(value) / 10, std::abs(value) % 10));
+    }
+
+    for (std::string_view rest = dataset.text; !rest.empty();) {
+        const auto delimiter  = rest.find(';');
+        const auto line_break = rest.find('\n');
+        dataset.names.push_back(rest.substr(0, delimiter));
+        dataset.temperatures.push_back(rest.substr(delimiter + 1, line_break - delimiter - 1));
+        rest.remove_prefix(line_break + 1);
+    }
+    return dataset;
+}
+
+[[nodiscard]] std::size_t total_size(const std::vector<std::string_view>& views) {
+    std::size_t size = 0;
+    for (const auto view : views) {
+        size += view.size();
+    }
+    return size;
+}
+
+void run_benchmarks(const Config& config, const Dataset& dataset, std::vector<Measurement>& results) {
+    const auto  rows       = dataset.names.size();
+    const auto  text       = std::string_view{dataset.text};
+    const auto  name_bytes = total_size(dataset.names);
+    const char* text_end   = text.data() + text.size();
+
+    measure(config, results, "parse_temperature", rows, total_size(dataset.temperatures), [&] {
+        std::int64_t sum = 0;
+        for (const auto field : dataset.temperatures) {
+            sum += parse_temperature(field);
+        }
+        keep(sum);
+    });
+
+    measure(config, results, "decode_temperature", rows, total_size(dataset.temperatures), [&] {
+        std::int64_t sum = 0;
+        for (const auto field : dataset.temperatures) {
+            sum += decode_temperature(load_word(field.data(), text_end)).value;
+        }
+        keep(sum);
+    });
+
+    measure(config, results, "hash/fnv1a", rows, name_bytes, [&] {
+        const StringHasher hasher;
+        std::uint64_t      sum = 0;
+        for (const auto name : dataset.names) {
+            sum += hasher(name);
+        }
+        keep(sum);
+    });
+
+    measure(config, results, "hash/word", rows, name_bytes, [&] {
+        const WordHasher hasher;
+        std::uint64_t    sum = 0;
+        for (const auto name : dataset.names) {
+            sum += hasher(name);
+        }
+        keep(sum);
+    });
+
+    measure(config, results, "hash/word-scan", rows, name_bytes, [&] {
+        std::uint64_t sum = 0;
+        for (const auto name : dataset.names) {
+            sum += WordHasher::scan(name.data(), text_end).hash;
+        }
+        keep(sum);
+    });
+
+    Registry populated;
+    for (const auto& station : dataset.stations) {
+        populated.add(station, 0);
+    }
+
+    measure(config, results, "registry/lookup", rows, name_bytes, [&] {
+        std::uint64_t found = 0;
+        for (const auto name : dataset.names) {
+            found += populated.find(name)->count;
+        }
+        keep(found);
+    });
+
+    measure(
+        config,
+        results,
+        "registry/insert",
+        dataset.stations.size(),
+        0,
+        [] { return Registry(); },
+        [&](Registry& registry) {
+            for (const auto& station : dataset.stations) {
+                registry.add(station, 0);
+            }
+            keep(registry.size());
+        }
+    );
+
+    measure(
+        config,
+        results,
+        "registry/add",
+        rows,
+        name_bytes,
+        [&] { return populated; },
+        [&](Registry& registry) {
+            for (std::size_t i = 0; i != rows; ++i) {
+                registry.add(dataset.names[i], 1);
+            }
+            keep(registry.size());
+        }
+    );
+
+    measure(
+        config,
+        results,
+        "process_chunk",
+        rows,
+        text.size(),
+        [] { return Registry(); },
+        [&](Registry& registry) {
+            process_chunk(text, registry);
+            keep(registry.size());
+        }
+    );
+
+    // the same rows over the known station set, through the registry alone and through the compile-time perfect hash
+    const auto known_text = make_known_text(rows);
+
+    StationDictionary known_dictionary;  // the dense tables of the aggregator, which look known names up in the hash
+
+    measure(
+        config,
+        results,
+        "known/registry",
+        rows,
+        known_text.size(),
+        [] { return Registry(); },
+        [&](Registry& registry) {
+            process_chunk(known_text, registry);
+            keep(registry.size());
+        }
+    );
+
+    measure(
+        config,
+        results,
+        "known/perfect-hash",
+        rows,
+        known_text.size(),
+        [] { return Registry(); },
+        [&](Registry&) {
+            DenseTable table(known_dictionary);
+            process_chunk(known_text, table);
+            keep(table.size());
+        }
+    );
+
+    // seek_to works on a stream, so it is measured against a scratch copy of the dataset
+    const auto scratch_path = std::filesystem::temp_directory_path() / "brc-bench.txt";
+    {
+        std::ofstream scratch(scratch_path, std::ios::binary);
+        scratch.write(text.data(), static_cast<std::streamsize>(text.size()));
+    }
+    {
+        constexpr std::size_t seeks = 1024;
+
+        std::ifstream source(scratch_path, std::ios::binary);
+        measure(config, results, "seek_to", seeks, 0, [&] {
+            std::uint64_t sum = 0;
+            for (std::size_t i = 0; i != seeks; ++i) {
+                sum += seek_to(source, i * text.size() / seeks, '\n');
+            }
+            keep(sum);
+        });
+    }
+    std::filesystem::remove(scratch_path);
+
+    std::vector<Registry> partitions(config.partitions);
+    for (std::size_t i = 0; i != rows; ++i) {
+        partitions[i % partitions.size()].add(dataset.names[i], 1);
+    }
+
+    std::size_t partial_records = 0;
+    for (const auto& partition : partitions) {
+        partial_records += partition.size();
+    }
+
+    measure(
+        config,
+        results,
+        "gather",
+        partial_records,
+        0,
+        [&] { return partitions; },
+        [&](std::vector<Registry>& copies) { keep(gather(std::move(copies)).size()); }
+    );
+}
+
+// Fills a registry with `stations` the way the aggregator does and reports how `Hasher` spread them: full 64-bit hash
+// collisions, keys displaced from their home slot, and the mean and longest probe sequence of a lookup.
+template <typename Hasher>
+void print_hash_quality(std::string_view name, const std::vector<std::string_view>& stations) {
+    BasicRegistry<Hasher> registry;
+    for (const auto station : stations) {
+        registry.add(station, 0);
+    }
+
+    TableStats table;
+    table.record(registry);
+    std::cout << std::format(
+        "{:<16} {:>8} {:>8} {:>10} {:>10} {:>10.3f} {:>10}\n",
+        name,
+        table.stations,
+        table.capacity,
+        table.hash_collisions,
+        table.displaced_keys(),
+        table.mean_probe_length(),
+        table.probe_histogram.size()
+    );
+}
+
+void print_hash_quality() {
+    std::vector<std::string_view> known;
+    for (const auto& station : KNOWN_STATIONS) {
+        known.push_back(station.name);
+    }
+
+    const auto                          synthetic = make_dataset(0, 10'000);
+    const std::vector<std::string_view> generated(synthetic.stations.begin(), synthetic.stations.end());
+
+    std::cout << std::format(
+        "{:<16} {:>8} {:>8} {:>10} {:>10} {:>10} {:>10}\n",
+        "hasher/stations",
+        "keys",
+        "slots",
+        "64-bit",
+        "displaced",
+        "mean probe",
+        "max probe"
+    );
+    print_hash_quality<StringHasher>("fnv1a/known", known);
+    print_hash_quality<WordHasher>("word/known", known);
+    print_hash_quality<StringHasher>("fnv1a/10k", generated);
+    print_hash_quality<WordHasher>("word/10k", generated);
+}
+
+void print_text(std::ostream& output, const std::vector<Measurement>& results) {
+    output << std::format(
+        "{:<24} {:>12} {:>12} {:>12} {:>14}\n", "benchmark", "median ns/op", "p99 ns/op", "min ns/op", "MB/s"
+    );
+    for (const auto& result : results) {
+        const auto throughput = (result.bytes != 0) ? std::format("{:.1f}", result.bytes_per_second() / 1e6) : "-";
+        output << std::format(
+            "{:<24} {:>12.2f} {:>12.2f} {:>12.2f} {:>14}\n",
+            result.name,
+            result.ns_per_op(result.percentile(0.5)),
+            result.ns_per_op(result.percentile(0.99)),
+            result.ns_per_op(result.seconds.front()),
+            throughput
+        );
+    }
+}
+
+void write_json(std::ostream& output, const Config& config, const std::vector<Measurement>& results) {
+    output << "{\n";
+    output << std::format(
+        "    \"config\": {{\"repetitions\": {}, \"warmup\": {}, \"rows\": {}, \"stations\": {}, \"partitions\": {}}},\n",
+        config.repetitions,
+        config.warmup,
+        config.rows,
+        config.stations,
+        config.partitions
+    );
+    output << "    \"benchmarks\": [\n";
+    for (std::size_t i = 0; i != results.size(); ++i) {
+        const auto& result = results[i];
+        output << std::format(
+            "        {{\"name\": \"{}\", \"operations\": {}, \"bytes\": {}, \"repetitions\": {}, "
+            "\"median_ns_per_op\": {:.3f}, \"p99_ns_per_op\": {:.3f}, \"min_ns_per_op\": {:.3f}, "
+            "\"bytes_per_second\": {:.0f}}}{}\n",
+            result.name,
+            result.operations,
+            result.bytes,
+            result.seconds.size(),
+            result.ns_per_op(result.percentile(0.5)),
+            result.ns_per_op(result.percentile(0.99)),
+            result.ns_per_op(result.seconds.front()),
+            (result.bytes != 0) ? result.bytes_per_second() : 0.0,
+            (i + 1 != results.size()) ? "," : ""
+        );
+    }
+    output << "    ]\n}\n";
+}
+
+void print_usage() {
+    std::cout << "Usage: brc-bench [options]\n"
+                 "  --repetitions N   Timed repetitions per benchmark (default 50)\n"
+                 "  --warmup N        Discarded repetitions before timing (default 5)\n"
+                 "  --rows N          Rows in the synthetic dataset (default 1000000)\n"
+                 "  --stations N      Distinct stations in the dataset (default 413)\n"
+                 "  --partitions N    Partial registries merged by the gather benchmark (default 16)\n"
+                 "  --filter TEXT     Only run benchmarks whose name contains TEXT\n"
+                 "  --json PATH       Also write the results as JSON to PATH ('-' for stdout)\n"
+                 "  --hash-quality    Report how both hashers spread the known and 10000 synthetic stations, then exit\n";
+}
+
+int main(int argc, const char* argv[]) {
+    Config config;
+
+    const std::vector<std::string_view> args(argv + 1, argv + argc);
+    for (std::size_t i = 0; i != args.size(); ++i) {
+        const auto option = args[i];
+        if (option == "--help") {
+            print_usage();
+            return 0;
+        }
+        if (option == "--hash-quality") {
+            print_hash_quality();
+            return 0;
+        }
+
+        if (i + 1 == args.size()) {
+            std::cout << std::format("Missing value for {}\n", option);
+            return 1;
+        }
+
+        const auto value = std::string(args[++i]);
+        try {
+            if (option == "--repetitions") {
+                config.repetitions = std::max<std::size_t>(std::stoull(value), 1);
+            } else if (option == "--warmup") {
+                config.warmup = std::stoull(value);
+            } else if (option == "--rows") {
+                config.rows = std::max<std::size_t>(std::stoull(value), 1);
+            } else if (option == "--stations") {
+                config.stations = std::max<std::size_t>(std::stoull(value), 1);
+            } else if (option == "--partitions") {
+                config.partitions = std::max<std::size_t>(std::stoull(value), 1);
+            } else if (option == "--filter") {
+                config.filter = value;
+            } else if (option == "--json") {
+                config.json_path = value;
+            } else {
+                std::cout << std::format("Unknown option: {}\n", option);
+                return 1;
+            }
+        } catch (const std::logic_error&) {
+            std::cout << std::format("Invalid value for {}: {}\n", option, value);
+            return 1;
+        }
+    }
+
+    const auto dataset = make_dataset(config.rows, config.stations);
+
+    std::vector<Measurement> results;
+    run_benchmarks(config, dataset, results);
+
+    // with the JSON on stdout, the table goes to stderr so that stdout stays valid JSON
+    print_text((config.json_path == "-") ? std::cerr : std::cout, results);
+    if (config.json_path == "-") {
+        write_json(std::cout, config, results);
+    } else if (!config.json_path.empty()) {
+        std::ofstream output(config.json_path);
+        write_json(output, config, results);
+        if (!output.flush()) {
+            std::cout << std::format("Failed to write the results to {}\n", config.json_path);
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,42 @@
+#include <cstddef>
+#include <iostream>
+#include <span>
+#include <string_view>
+
+#include "brc-core.hpp"
+
+
+// The smallest program embedding `brc-core`: it links nothing but the library target, aggregates a buffer it holds in
+// memory, once at a time and once in pieces, and fails if either result is off. `ctest` runs it.
+
+constexpr std::string_view MEASUREMENTS = "Hamburg;12.0\nBulawayo;8.9\nHamburg;-3.4\nPalembang;38.8\nBulawayo;8.9";
+
+[[nodiscard]] bool check(const brc::Registry& registry, std::string_view source) {
+    const auto* hamburg  = registry.find("Hamburg");
+    const auto* bulawayo = registry.find("Bulawayo");
+    if (registry.size() != 3 || hamburg == nullptr || bulawayo == nullptr || registry.find("Palembang") == nullptr) {
+        std::cerr << source << ": wrong stations\n";
+        return false;
+    }
+    if (hamburg->min != -34 || hamburg->max != 120 || hamburg->sum != 86 || hamburg->count != 2
+        || bulawayo->count != 2) {
+        std::cerr << source << ": wrong statistics\n";
+        return false;
+    }
+    return true;
+}
+
+int main() {
+    const std::span<const char> data(MEASUREMENTS.data(), MEASUREMENTS.size());
+
+    const auto whole = brc::aggregate(data, 2);
+
+    // split inside a name and inside a temperature, so both buffers end in the middle of a record
+    brc::Aggregator aggregator;
+    aggregator.feed(data.first(17));
+    aggregator.feed(data.subspan(17, 20));
+    aggregator.feed(data.subspan(37));
+    const auto pieces = aggregator.finish();
+
+    return (check(whole, "aggregate") && check(pieces, "Aggregator")) ? 0 : 1;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "aggregation.hpp"
+#include "registry.hpp"
+#include "station-dictionary.hpp"
+
+
+namespace brc {
+    // The aggregation engine for programs that already hold the measurements in memory, e.g. network buffers or shared
+    // memory: the `brc-core` library target. Nothing is copied; the data is parsed where it lies.
+
+    // Aggregates whole records, `station;temperature` lines, on `cpu_count` threads. The last line may lack its line break.
+    [[nodiscard]] inline Registry aggregate(
+        std::span<const char> data,
+        std::size_t           cpu_count    = std::max(std::thread::hardware_concurrency(), 1u),
+        std::size_t           segment_size = DEFAULT_SEGMENT_SIZE_MB * 1024 * 1024
+    ) {
+        return process_measurements(std::string_view(data.data(), data.size()), cpu_count, segment_size);
+    }
+
+    // Combines two results, e.g. of aggregators fed on different threads or machines.
+    [[nodiscard]] inline Registry merge(Registry lhs, const Registry& rhs) {
+        if (lhs.size() < rhs.size()) {
+            Registry result = rhs;
+            result.merge(lhs);
+            return result;
+        }
+        lhs.merge(rhs);
+        return lhs;
+    }
+
+    // Aggregates data that arrives in pieces, on the calling thread. Buffers may end anywhere, even inside a record: the
+    // unfinished record is kept until the buffer that completes it, so only that one line is ever copied. Stations are
+    // numbered through a dictionary of the aggregator's own, as the workers of `aggregate` do.
+    class Aggregator {
+    public:
+        Aggregator()
+            : dictionary_(std::make_unique<StationDictionary>())
+            , table_(*dictionary_) {}
+
+        void feed(std::span<const char> buffer) {
+            std::string_view data(buffer.data(), buffer.size());
+            if (!carry_.empty()) {
+                const auto line_break = data.find('\n');
+                if (line_break == std::string_view::npos) {
+                    carry_.append(data);
+                    return;
+                }
+
+                carry_.append(data.substr(0, line_break + 1));
+                process_chunk(std::string_view(carry_), table_);
+                carry_.clear();
+                data.remove_prefix(line_break + 1);
+            }
+
+            const auto last_break = data.rfind('\n');
+            if (last_break == std::string_view::npos) {
+                carry_.assign(data);
+                return;
+            }
+            process_chunk(data.substr(0, last_break + 1), table_);
+            carry_.assign(data.substr(last_break + 1));
+        }
+
+        // Adds a result aggregated elsewhere.
+        void merge(const Registry& other) {
+            merged_.merge(other);
+        }
+
+        // Everything fed so far, including a last record without a line break. The aggregator starts over afterwards.
+        [[nodiscard]] Registry finish() {
+            if (!carry_.empty()) {
+                process_chunk(std::string_view(carry_), table_);
+                carry_.clear();
+            }
+
+            auto result = brc::merge(table_.to_registry(), merged_);
+            table_      = DenseTable(*dictionary_);
+            merged_     = Registry();
+            return result;
+        }
+
+    private:
+        std::unique_ptr<StationDictionary> dictionary_;
+        DenseTable                         table_;
+        Registry                           merged_;
+        std::string                        carry_;
+    };
+}  // namespace brc
@@ -0,0 +1,258 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+namespace brc {
+    // A fixed set of threads resuming whatever coroutines are handed to them, in the order they are handed over. A
+    // coroutine moves onto the pool by awaiting `schedule()`, and comes back to it whenever a `Channel` it waits on is
+    // ready.
+    class ThreadPool {
+    public:
+        explicit ThreadPool(std::size_t thread_count) {
+            for (std::size_t i = 0; i != std::max<std::size_t>(thread_count, 1); ++i) {
+                threads_.emplace_back([this] { run(); });
+            }
+        }
+
+        ThreadPool(const ThreadPool&)            = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        // Resumes what is still queued, then joins the threads.
+        ~ThreadPool() {
+            {
+                std::lock_guard lock(mutex_);
+                stopping_ = true;
+            }
+            ready_.notify_all();
+            for (auto& thread : threads_) {
+                thread.join();
+            }
+        }
+
+        void post(std::coroutine_handle<> handle) {
+            {
+                std::lock_guard lock(mutex_);
+                queue_.push_back(handle);
+            }
+            ready_.notify_one();
+        }
+
+        [[nodiscard]] auto schedule() {
+            struct Awaiter {
+                ThreadPool& pool;
+
+                [[nodiscard]] bool await_ready() const noexcept {
+                    return false;
+                }
+                void await_suspend(std::coroutine_handle<> handle) const {
+                    pool.post(handle);
+                }
+                void await_resume() const noexcept {}
+            };
+            return Awaiter{*this};
+        }
+
+    private:
+        void run() {
+            while (true) {
+                std::unique_lock lock(mutex_);
+                ready_.wait(lock, [this] { return !queue_.empty() || stopping_; });
+                if (queue_.empty()) {
+                    return;
+                }
+
+                const auto handle = queue_.front();
+                queue_.pop_front();
+                lock.unlock();
+                handle.resume();
+            }
+        }
+
+        std::vector<std::thread>            threads_;
+        std::mutex                          mutex_;
+        std::condition_variable             ready_;
+        std::deque<std::coroutine_handle<>> queue_;
+        bool                                stopping_ = false;
+    };
+
+    // A coroutine that starts when it is called and frees itself when it ends; nothing awaits it, so whoever needs it to
+    // be done has it count down a latch on its way out.
+    struct DetachedTask {
+        struct promise_type {
+            DetachedTask get_return_object() noexcept {
+                return {};
+            }
+            std::suspend_never initial_suspend() noexcept {
+                return {};
+            }
+            std::suspend_never final_suspend() noexcept {
+                return {};
+            }
+            void return_void() noexcept {}
+            void unhandled_exception() noexcept {
+                std::terminate();
+            }
+        };
+    };
+
+    // A bounded queue between coroutines on a `ThreadPool`. Pushing to a full channel or popping from an empty one suspends
+    // the coroutine instead of blocking its thread, which goes on with other work; the coroutine is posted back to the pool
+    // once its value has been taken or handed to it. Values pass straight from a pusher to a waiting popper. The channel
+    // closes when each of its `producer_count` producers has called `close`, after which pops drain what is left and then
+    // yield nothing.
+    template <typename T>
+    class Channel {
+    public:
+        class PushAwaiter {
+        public:
+            PushAwaiter(Channel& channel, T value)
+                : channel_(channel)
+                , value_(std::move(value)) {}
+
+            [[nodiscard]] bool await_ready() const noexcept {
+                return false;
+            }
+            [[nodiscard]] bool await_suspend(std::coroutine_handle<> handle) {
+                handle_ = handle;
+                return channel_.suspend_push(*this);
+            }
+            void await_resume() const noexcept {}
+
+        private:
+            friend class Channel;
+
+            Channel&                channel_;
+            T                       value_;
+            std::coroutine_handle<> handle_;
+        };
+
+        class PopAwaiter {
+        public:
+            explicit PopAwaiter(Channel& channel)
+                : channel_(channel) {}
+
+            [[nodiscard]] bool await_ready() const noexcept {
+                return false;
+            }
+            [[nodiscard]] bool await_suspend(std::coroutine_handle<> handle) {
+                handle_ = handle;
+                return channel_.suspend_pop(*this);
+            }
+            [[nodiscard]] std::optional<T> await_resume() {
+                return std::move(value_);
+            }
+
+        private:
+            friend class Channel;
+
+            Channel&                channel_;
+            std::optional<T>        value_;
+            std::coroutine_handle<> handle_;
+        };
+
+        Channel(ThreadPool& pool, std::size_t capacity, std::size_t producer_count = 1)
+            : pool_(pool)
+            , capacity_(std::max<std::size_t>(capacity, 1))
+            , producers_(producer_count) {}
+
+        Channel(const Channel&)            = delete;
+        Channel& operator=(const Channel&) = delete;
+
+        [[nodiscard]] PushAwaiter push(T value) {
+            return PushAwaiter(*this, std::move(value));
+        }
+
+        // Resumes with the next value, or with nothing once the channel is closed and drained.
+        [[nodiscard]] PopAwaiter pop() {
+            return PopAwaiter(*this);
+        }
+
+        // For filling the channel before any coroutine runs; false if it is full.
+        [[nodiscard]] bool try_push(T value) {
+            std::lock_guard lock(mutex_);
+            if (values_.size() >= capacity_) {
+                return false;
+            }
+            values_.push_back(std::move(value));
+            return true;
+        }
+
+        // One producer is done; the last one closes the channel and wakes the poppers still waiting.
+        void close() {
+            std::deque<PopAwaiter*> poppers;
+            {
+                std::lock_guard lock(mutex_);
+                if (--producers_ != 0) {
+                    return;
+                }
+                closed_ = true;
+                poppers.swap(poppers_);
+            }
+            for (auto* popper : poppers) {
+                pool_.post(popper->handle_);
+            }
+        }
+
+    private:
+        // Both return whether the coroutine stays suspended. A waiter is handed back to the pool once the lock is released.
+        [[nodiscard]] bool suspend_push(PushAwaiter& pusher) {
+            std::unique_lock lock(mutex_);
+            if (!poppers_.empty()) {
+                PopAwaiter* popper = poppers_.front();
+                poppers_.pop_front();
+                popper->value_ = std::move(pusher.value_);
+                lock.unlock();
+                pool_.post(popper->handle_);
+                return false;
+            }
+            if (values_.size() < capacity_) {
+                values_.push_back(std::move(pusher.value_));
+                return false;
+            }
+            pushers_.push_back(&pusher);
+            return true;
+        }
+
+        [[nodiscard]] bool suspend_pop(PopAwaiter& popper) {
+            std::unique_lock lock(mutex_);
+            if (values_.empty()) {
+                if (closed_) {
+                    return false;
+                }
+                poppers_.push_back(&popper);
+                return true;
+            }
+
+            popper.value_ = std::move(values_.front());
+            values_.pop_front();
+            if (!pushers_.empty()) {
+                PushAwaiter* pusher = pushers_.front();
+                pushers_.pop_front();
+                values_.push_back(std::move(pusher->value_));
+                lock.unlock();
+                pool_.post(pusher->handle_);
+            }
+            return false;
+        }
+
+        ThreadPool&              pool_;
+        std::size_t              capacity_;
+        std::size_t              producers_;
+        std::mutex               mutex_;
+        std::deque<T>            values_;
+        std::deque<PushAwaiter*> pushers_;
+        std::deque<PopAwaiter*>  poppers_;
+        bool                     closed_ = false;
+    };
+}  // namespace brc
@@ -1,16 +1,30 @@
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
 #include <filesystem>
 #include <format>
 #include <fstream>
 #include <iostream>
+#include <mutex>
+#include <optional>
 #include <random>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
 
 #include <cxxopts.hpp>
 
+#include "binary-measurements.hpp"
+#include "weather-stations.hpp"
 
+
+using namespace brc;
+
+using Generator         = std::mt19937;
 using IntDisribution    = std::uniform_int_distribution<std::size_t>;
 using NotmalDistibution = std::normal_distribution<float>;
 
@@ -18,430 +32,21 @@ struct WeatherStation {
     std::string name;
     float       mean_temperature;
 
-    [[nodiscard]] float measurement() const {
-        static const auto                 seed = std::chrono::system_clock::now().time_since_epoch().count();
-        static std::default_random_engine generator(seed);
-
-        NotmalDistibution distribution(mean_temperature, 10.0f);
-        return std::round(distribution(generator) * 10.0f) / 10.0f;
+    // Returns the temperature in tenths of a degree, clamped to the [-99.9, 99.9] range of the challenge.
+    // `deviation` is expected to be centered on zero, so one distribution can serve every station.
+    [[nodiscard]] int measurement(Generator& generator, NotmalDistibution& deviation) const {
+        const auto tenths = std::lround((mean_temperature + deviation(generator)) * 10.0f);
+        return static_cast<int>(std::clamp(tenths, -999L, 999L));
     }
 };
 
-const std::vector<WeatherStation> WEATHER_STATIONS = {
-    {"Abha", 18.0},
-    {"Abidjan", 26.0},
-    {"Abéché", 29.4},
-    {"Accra", 26.4},
-    {"Addis Ababa", 16.0},
-    {"Adelaide", 17.3},
-    {"Aden", 29.1},
-    {"Ahvaz", 25.4},
-    {"Albuquerque", 14.0},
-    {"Alexandra", 11.0},
-    {"Alexandria", 20.0},
-    {"Algiers", 18.2},
-    {"Alice Springs", 21.0},
-    {"Almaty", 10.0},
-    {"Amsterdam", 10.2},
-    {"Anadyr", -6.9},
-    {"Anchorage", 2.8},
-    {"Andorra la Vella", 9.8},
-    {"Ankara", 12.0},
-    {"Antananarivo", 17.9},
-    {"Antsiranana", 25.2},
-    {"Arkhangelsk", 1.3},
-    {"Ashgabat", 17.1},
-    {"Asmara", 15.6},
-    {"Assab", 30.5},
-    {"Astana", 3.5},
-    {"Athens", 19.2},
-    {"Atlanta", 17.0},
-    {"Auckland", 15.2},
-    {"Austin", 20.7},
-    {"Baghdad", 22.77},
-    {"Baguio", 19.5},
-    {"Baku", 15.1},
-    {"Baltimore", 13.1},
-    {"Bamako", 27.8},
-    {"Bangkok", 28.6},
-    {"Bangui", 26.0},
-    {"Banjul", 26.0},
-    {"Barcelona", 18.2},
-    {"Bata", 25.1},
-    {"Batumi", 14.0},
-    {"Beijing", 12.9},
-    {"Beirut", 20.9},
-    {"Belgrade", 12.5},
-    {"Belize City", 26.7},
-    {"Benghazi", 19.9},
-    {"Bergen", 7.7},
-    {"Berlin", 10.3},
-    {"Bilbao", 14.7},
-    {"Birao", 26.5},
-    {"Bishkek", 11.3},
-    {"Bissau", 27.0},
-    {"Blantyre", 22.2},
-    {"Bloemfontein", 15.6},
-    {"Boise", 11.4},
-    {"Bordeaux", 14.2},
-    {"Bosaso", 30.0},
-    {"Boston", 10.9},
-    {"Bouaké", 26.0},
-    {"Bratislava", 10.5},
-    {"Brazzaville", 25.0},
-    {"Bridgetown", 27.0},
-    {"Brisbane", 21.4},
-    {"Brussels", 10.5},
-    {"Bucharest", 10.8},
-    {"Budapest", 11.3},
-    {"Bujumbura", 23.8},
-    {"Bulawayo", 18.9},
-    {"Burnie", 13.1},
-    {"Busan", 15.0},
-    {"Cabo San Lucas", 23.9},
-    {"Cairns", 25.0},
-    {"Cairo", 21.4},
-    {"Calgary", 4.4},
-    {"Canberra", 13.1},
-    {"Cape Town", 16.2},
-    {"Changsha", 17.4},
-    {"Charlotte", 16.1},
-    {"Chiang Mai", 25.8},
-    {"Chicago", 9.8},
-    {"Chihuahua", 18.6},
-    {"Chișinău", 10.2},
-    {"Chittagong", 25.9},
-    {"Chongqing", 18.6},
-    {"Christchurch", 12.2},
-    {"City of San Marino", 11.8},
-    {"Colombo", 27.4},
-    {"Columbus", 11.7},
-    {"Conakry", 26.4},
-    {"Copenhagen", 9.1},
-    {"Cotonou", 27.2},
-    {"Cracow", 9.3},
-    {"Da Lat", 17.9},
-    {"Da Nang", 25.8},
-    {"Dakar", 24.0},
-    {"Dallas", 19.0},
-    {"Damascus", 17.0},
-    {"Dampier", 26.4},
-    {"Dar es Salaam", 25.8},
-    {"Darwin", 27.6},
-    {"Denpasar", 23.7},
-    {"Denver", 10.4},
-    {"Detroit", 10.0},
-    {"Dhaka", 25.9},
-    {"Dikson", -11.1},
-    {"Dili", 26.6},
-    {"Djibouti", 29.9},
-    {"Dodoma", 22.7},
-    {"Dolisie", 24.0},
-    {"Douala", 26.7},
-    {"Dubai", 26.9},
-    {"Dublin", 9.8},
-    {"Dunedin", 11.1},
-    {"Durban", 20.6},
-    {"Dushanbe", 14.7},
-    {"Edinburgh", 9.3},
-    {"Edmonton", 4.2},
-    {"El Paso", 18.1},
-    {"Entebbe", 21.0},
-    {"Erbil", 19.5},
-    {"Erzurum", 5.1},
-    {"Fairbanks", -2.3},
-    {"Fianarantsoa", 17.9},
-    {"Flores,  Petén", 26.4},
-    {"Frankfurt", 10.6},
-    {"Fresno", 17.9},
-    {"Fukuoka", 17.0},
-    {"Gabès", 19.5},
-    {"Gaborone", 21.0},
-    {"Gagnoa", 26.0},
-    {"Gangtok", 15.2},
-    {"Garissa", 29.3},
-    {"Garoua", 28.3},
-    {"George Town", 27.9},
-    {"Ghanzi", 21.4},
-    {"Gjoa Haven", -14.4},
-    {"Guadalajara", 20.9},
-    {"Guangzhou", 22.4},
-    {"Guatemala City", 20.4},
-    {"Halifax", 7.5},
-    {"Hamburg", 9.7},
-    {"Hamilton", 13.8},
-    {"Hanga Roa", 20.5},
-    {"Hanoi", 23.6},
-    {"Harare", 18.4},
-    {"Harbin", 5.0},
-    {"Hargeisa", 21.7},
-    {"Hat Yai", 27.0},
-    {"Havana", 25.2},
-    {"Helsinki", 5.9},
-    {"Heraklion", 18.9},
-    {"Hiroshima", 16.3},
-    {"Ho Chi Minh City", 27.4},
-    {"Hobart", 12.7},
-    {"Hong Kong", 23.3},
-    {"Honiara", 26.5},
-    {"Honolulu", 25.4},
-    {"Houston", 20.8},
-    {"Ifrane", 11.4},
-    {"Indianapolis", 11.8},
-    {"Iqaluit", -9.3},
-    {"Irkutsk", 1.0},
-    {"Istanbul", 13.9},
-    {"İzmir", 17.9},
-    {"Jacksonville", 20.3},
-    {"Jakarta", 26.7},
-    {"Jayapura", 27.0},
-    {"Jerusalem", 18.3},
-    {"Johannesburg", 15.5},
-    {"Jos", 22.8},
-    {"Juba", 27.8},
-    {"Kabul", 12.1},
-    {"Kampala", 20.0},
-    {"Kandi", 27.7},
-    {"Kankan", 26.5},
-    {"Kano", 26.4},
-    {"Kansas City", 12.5},
-    {"Karachi", 26.0},
-    {"Karonga", 24.4},
-    {"Kathmandu", 18.3},
-    {"Khartoum", 29.9},
-    {"Kingston", 27.4},
-    {"Kinshasa", 25.3},
-    {"Kolkata", 26.7},
-    {"Kuala Lumpur", 27.3},
-    {"Kumasi", 26.0},
-    {"Kunming", 15.7},
-    {"Kuopio", 3.4},
-    {"Kuwait City", 25.7},
-    {"Kyiv", 8.4},
-    {"Kyoto", 15.8},
-    {"La Ceiba", 26.2},
-    {"La Paz", 23.7},
-    {"Lagos", 26.8},
-    {"Lahore", 24.3},
-    {"Lake Havasu City", 23.7},
-    {"Lake Tekapo", 8.7},
-    {"Las Palmas de Gran Canaria", 21.2},
-    {"Las Vegas", 20.3},
-    {"Launceston", 13.1},
-    {"Lhasa", 7.6},
-    {"Libreville", 25.9},
-    {"Lisbon", 17.5},
-    {"Livingstone", 21.8},
-    {"Ljubljana", 10.9},
-    {"Lodwar", 29.3},
-    {"Lomé", 26.9},
-    {"London", 11.3},
-    {"Los Angeles", 18.6},
-    {"Louisville", 13.9},
-    {"Luanda", 25.8},
-    {"Lubumbashi", 20.8},
-    {"Lusaka", 19.9},
-    {"Luxembourg City", 9.3},
-    {"Lviv", 7.8},
-    {"Lyon", 12.5},
-    {"Madrid", 15.0},
-    {"Mahajanga", 26.3},
-    {"Makassar", 26.7},
-    {"Makurdi", 26.0},
-    {"Malabo", 26.3},
-    {"Malé", 28.0},
-    {"Managua", 27.3},
-    {"Manama", 26.5},
-    {"Mandalay", 28.0},
-    {"Mango", 28.1},
-    {"Manila", 28.4},
-    {"Maputo", 22.8},
-    {"Marrakesh", 19.6},
-    {"Marseille", 15.8},
-    {"Maun", 22.4},
-    {"Medan", 26.5},
-    {"Mek'ele", 22.7},
-    {"Melbourne", 15.1},
-    {"Memphis", 17.2},
-    {"Mexicali", 23.1},
-    {"Mexico City", 17.5},
-    {"Miami", 24.9},
-    {"Milan", 13.0},
-    {"Milwaukee", 8.9},
-    {"Minneapolis", 7.8},
-    {"Minsk", 6.7},
-    {"Mogadishu", 27.1},
-    {"Mombasa", 26.3},
-    {"Monaco", 16.4},
-    {"Moncton", 6.1},
-    {"Monterrey", 22.3},
-    {"Montreal", 6.8},
-    {"Moscow", 5.8},
-    {"Mumbai", 27.1},
-    {"Murmansk", 0.6},
-    {"Muscat", 28.0},
-    {"Mzuzu", 17.7},
-    {"N'Djamena", 28.3},
-    {"Naha", 23.1},
-    {"Nairobi", 17.8},
-    {"Nakhon Ratchasima", 27.3},
-    {"Napier", 14.6},
-    {"Napoli", 15.9},
-    {"Nashville", 15.4},
-    {"Nassau", 24.6},
-    {"Ndola", 20.3},
-    {"New Delhi", 25.0},
-    {"New Orleans", 20.7},
-    {"New York City", 12.9},
-    {"Ngaoundéré", 22.0},
-    {"Niamey", 29.3},
-    {"Nicosia", 19.7},
-    {"Niigata", 13.9},
-    {"Nouadhibou", 21.3},
-    {"Nouakchott", 25.7},
-    {"Novosibirsk", 1.7},
-    {"Nuuk", -1.4},
-    {"Odesa", 10.7},
-    {"Odienné", 26.0},
-    {"Oklahoma City", 15.9},
-    {"Omaha", 10.6},
-    {"Oranjestad", 28.1},
-    {"Oslo", 5.7},
-    {"Ottawa", 6.6},
-    {"Ouagadougou", 28.3},
-    {"Ouahigouya", 28.6},
-    {"Ouarzazate", 18.9},
-    {"Oulu", 2.7},
-    {"Palembang", 27.3},
-    {"Palermo", 18.5},
-    {"Palm Springs", 24.5},
-    {"Palmerston North", 13.2},
-    {"Panama City", 28.0},
-    {"Parakou", 26.8},
-    {"Paris", 12.3},
-    {"Perth", 18.7},
-    {"Petropavlovsk-Kamchatsky", 1.9},
-    {"Philadelphia", 13.2},
-    {"Phnom Penh", 28.3},
-    {"Phoenix", 23.9},
-    {"Pittsburgh", 10.8},
-    {"Podgorica", 15.3},
-    {"Pointe-Noire", 26.1},
-    {"Pontianak", 27.7},
-    {"Port Moresby", 26.9},
-    {"Port Sudan", 28.4},
-    {"Port Vila", 24.3},
-    {"Port-Gentil", 26.0},
-    {"Portland (OR)", 12.4},
-    {"Porto", 15.7},
-    {"Prague", 8.4},
-    {"Praia", 24.4},
-    {"Pretoria", 18.2},
-    {"Pyongyang", 10.8},
-    {"Rabat", 17.2},
-    {"Rangpur", 24.4},
-    {"Reggane", 28.3},
-    {"Reykjavík", 4.3},
-    {"Riga", 6.2},
-    {"Riyadh", 26.0},
-    {"Rome", 15.2},
-    {"Roseau", 26.2},
-    {"Rostov-on-Don", 9.9},
-    {"Sacramento", 16.3},
-    {"Saint Petersburg", 5.8},
-    {"Saint-Pierre", 5.7},
-    {"Salt Lake City", 11.6},
-    {"San Antonio", 20.8},
-    {"San Diego", 17.8},
-    {"San Francisco", 14.6},
-    {"San Jose", 16.4},
-    {"San José", 22.6},
-    {"San Juan", 27.2},
-    {"San Salvador", 23.1},
-    {"Sana'a", 20.0},
-    {"Santo Domingo", 25.9},
-    {"Sapporo", 8.9},
-    {"Sarajevo", 10.1},
-    {"Saskatoon", 3.3},
-    {"Seattle", 11.3},
-    {"Ségou", 28.0},
-    {"Seoul", 12.5},
-    {"Seville", 19.2},
-    {"Shanghai", 16.7},
-    {"Singapore", 27.0},
-    {"Skopje", 12.4},
-    {"Sochi", 14.2},
-    {"Sofia", 10.6},
-    {"Sokoto", 28.0},
-    {"Split", 16.1},
-    {"St. John's", 5.0},
-    {"St. Louis", 13.9},
-    {"Stockholm", 6.6},
-    {"Surabaya", 27.1},
-    {"Suva", 25.6},
-    {"Suwałki", 7.2},
-    {"Sydney", 17.7},
-    {"Tabora", 23.0},
-    {"Tabriz", 12.6},
-    {"Taipei", 23.0},
-    {"Tallinn", 6.4},
-    {"Tamale", 27.9},
-    {"Tamanrasset", 21.7},
-    {"Tampa", 22.9},
-    {"Tashkent", 14.8},
-    {"Tauranga", 14.8},
-    {"Tbilisi", 12.9},
-    {"Tegucigalpa", 21.7},
-    {"Tehran", 17.0},
-    {"Tel Aviv", 20.0},
-    {"Thessaloniki", 16.0},
-    {"Thiès", 24.0},
-    {"Tijuana", 17.8},
-    {"Timbuktu", 28.0},
-    {"Tirana", 15.2},
-    {"Toamasina", 23.4},
-    {"Tokyo", 15.4},
-    {"Toliara", 24.1},
-    {"Toluca", 12.4},
-    {"Toronto", 9.4},
-    {"Tripoli", 20.0},
-    {"Tromsø", 2.9},
-    {"Tucson", 20.9},
-    {"Tunis", 18.4},
-    {"Ulaanbaatar", -0.4},
-    {"Upington", 20.4},
-    {"Ürümqi", 7.4},
-    {"Vaduz", 10.1},
-    {"Valencia", 18.3},
-    {"Valletta", 18.8},
-    {"Vancouver", 10.4},
-    {"Veracruz", 25.4},
-    {"Vienna", 10.4},
-    {"Vientiane", 25.9},
-    {"Villahermosa", 27.1},
-    {"Vilnius", 6.0},
-    {"Virginia Beach", 15.8},
-    {"Vladivostok", 4.9},
-    {"Warsaw", 8.5},
-    {"Washington, D.C.", 14.6},
-    {"Wau", 27.8},
-    {"Wellington", 12.9},
-    {"Whitehorse", -0.1},
-    {"Wichita", 13.9},
-    {"Willemstad", 28.0},
-    {"Winnipeg", 3.0},
-    {"Wrocław", 9.6},
-    {"Xi'an", 14.1},
-    {"Yakutsk", -8.8},
-    {"Yangon", 27.5},
-    {"Yaoundé", 23.8},
-    {"Yellowknife", -4.3},
-    {"Yerevan", 12.4},
-    {"Yinchuan", 9.0},
-    {"Zagreb", 10.7},
-    {"Zanzibar City", 26.0},
-    {"Zürich", 9.3},
-};
+const std::vector<WeatherStation> WEATHER_STATIONS = [] {
+    std::vector<WeatherStation> stations;
+    for (const auto& station : KNOWN_STATIONS) {
+        stations.push_back({std::string(station.name), station.mean_temperature});
+    }
+    return stations;
+}();
 
 const std::size_t CHUNK_SIZE = 100000;
 
@@ -461,31 +66,216 @@ std::string time_past_since(const std::chrono::system_clock::time_point& start_p
     return std::format("{:02d}:{:02d}.{:03d}", minutes.count(), seconds.count(), milliseconds.count());
 }
 
-void generate_measurements(const std::filesystem::path& file, std::size_t records) {
-    std::ofstream outfile(file, std::ios::binary);
-    if (!outfile) {
+[[nodiscard]] std::uint64_t random_seed() {
+    std::random_device device;
+    return (static_cast<std::uint64_t>(device()) << 32) | device();
+}
+
+// Appends "<station>;<temperature>\n" with the temperature printed as "-?d?d.d".
+void append_measurement(std::string& buffer, std::string_view station, int temperature) {
+    buffer.append(station);
+    buffer.push_back(';');
+    if (temperature < 0) {
+        buffer.push_back('-');
+        temperature = -temperature;
+    }
+    if (temperature >= 100) {
+        buffer.push_back(static_cast<char>('0' + temperature / 100));
+    }
+    buffer.push_back(static_cast<char>('0' + temperature / 10 % 10));
+    buffer.push_back('.');
+    buffer.push_back(static_cast<char>('0' + temperature % 10));
+    buffer.push_back('\n');
+}
+
+constexpr std::size_t MIN_NAME_LENGTH   = 3;
+constexpr std::size_t SHORT_NAME_LENGTH = 24;
+constexpr std::size_t LONG_NAME_LENGTH  = 100;  // the longest name the challenge allows, in bytes
+
+// Letters of synthetic UTF-8 names beyond a-z: two-byte Latin, Greek and Cyrillic letters and three-byte CJK ones,
+// spelled out as bytes so the source does not depend on the compiler's execution character set.
+constexpr std::string_view UTF8_LETTERS[] = {
+    "\xc3\xa0", "\xc3\xa9", "\xc3\xae", "\xc3\xb1", "\xc3\xb6", "\xc3\xbc", "\xc3\xa7", "\xc3\xb8", "\xc3\xa5",
+    "\xc5\x82", "\xc5\x9f", "\xc4\x9f", "\xc5\xbe", "\xce\xb1", "\xce\xb2", "\xce\xb3", "\xce\xbb", "\xcf\x80",
+    "\xd0\xb4", "\xd0\xb6", "\xd1\x88", "\xd1\x8f", "\xe5\xb1\xb1", "\xe5\xb7\x9d", "\xe6\x9d\xb1", "\xe4\xba\xac",
+    "\xe7\x94\xba", "\xe5\xb8\x82",
+};
+
+enum class NameLengths { uniform, normal };
+
+struct NameOptions {
+    std::size_t min_length = MIN_NAME_LENGTH;    // in bytes
+    std::size_t max_length = SHORT_NAME_LENGTH;  // in bytes
+    NameLengths lengths    = NameLengths::uniform;
+    bool        utf8       = false;  // mix multi-byte letters into the names
+};
+
+// Builds `count` distinct stations with mean temperatures in [-10, 30], derived from `seed` only. Name lengths are
+// drawn from `names`, either uniformly or normally around the middle of the range, and count bytes rather than
+// characters, so a UTF-8 letter that does not fit is replaced by an ASCII one. Names end with the station index, which
+// keeps them distinct; a name too short for its index is lengthened, so `names.max_length` must leave room for at least
+// one letter and the digits of `count - 1`.
+[[nodiscard]] std::vector<WeatherStation> make_synthetic_stations(
+    std::size_t count, const NameOptions& names, std::uint64_t seed
+) {
+    std::seed_seq sequence{static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32), 0x5747u};
+    Generator     generator(sequence);
+
+    const auto middle = static_cast<float>(names.min_length + names.max_length) / 2.0f;
+    const auto spread = static_cast<float>(names.max_length - names.min_length) / 6.0f;
+
+    std::uniform_int_distribution<std::size_t> uniform_length(names.min_length, names.max_length);
+    std::normal_distribution<float>            normal_length(middle, std::max(spread, 0.5f));
+    std::uniform_int_distribution<int>         letter('a', 'z');
+    std::uniform_int_distribution<std::size_t> utf8_letter(0, std::size(UTF8_LETTERS) + ('z' - 'a'));
+    std::uniform_real_distribution<float>      mean(-10.0f, 30.0f);
+
+    const auto draw_length = [&] {
+        if (names.lengths == NameLengths::uniform) {
+            return uniform_length(generator);
+        }
+        const auto length = std::lround(normal_length(generator));
+        return static_cast<std::size_t>(std::clamp<long>(length, names.min_length, names.max_length));
+    };
+
+    std::vector<WeatherStation> stations;
+    stations.reserve(count);
+    for (std::size_t i = 0; i != count; ++i) {
+        const auto suffix = std::to_string(i);
+        const auto size   = std::max(draw_length(), suffix.size() + 1);
+
+        std::string name(size - suffix.size(), ' ');
+        if (!names.utf8) {
+            std::generate(name.begin(), name.end(), [&] { return static_cast<char>(letter(generator)); });
+            name.front() = static_cast<char>(name.front() - 'a' + 'A');
+        } else {
+            const auto target = name.size();
+            name.clear();
+            while (name.size() != target) {
+                const auto index = utf8_letter(generator);
+                if (index < std::size(UTF8_LETTERS) && name.size() + UTF8_LETTERS[index].size() <= target) {
+                    name.append(UTF8_LETTERS[index]);
+                } else {
+                    name.push_back(static_cast<char>('a' + index % ('z' - 'a' + 1)));
+                }
+            }
+        }
+
+        const auto mean_temperature = std::round(mean(generator) * 10.0f) / 10.0f;
+        stations.push_back({name + suffix, mean_temperature});
+    }
+    return stations;
+}
+
+enum class OutputFormat { text, binary };
+
+// Every chunk of records gets its own generator seeded from (seed, chunk index), so the file depends on the seed alone
+// and not on how many threads produced it. Threads claim chunks in order, generate them into private buffers and take
+// turns appending them to the file, which keeps the output ordered with one buffer per thread in flight. Returns false
+// if the file cannot be opened or a write fails, after which no further chunk is generated.
+[[nodiscard]] bool generate_measurements(
+    const std::filesystem::path&       file,
+    const std::vector<WeatherStation>& stations,
+    std::size_t                        records,
+    std::uint64_t                      seed,
+    std::size_t                        thread_count,
+    OutputFormat                       output_format
+) {
+    std::ofstream               outfile;
+    std::optional<BinaryWriter> binary;
+    if (output_format == OutputFormat::binary) {
+        binary.emplace(file);
+    } else {
+        outfile.open(file, std::ios::binary);
+    }
+
+    if (binary ? !binary->good() : !outfile) {
         std::cerr << "Failed to open file for writing.\n";
-        return;
+        return false;
     }
 
-    const auto         start_point = std::chrono::system_clock::now();
-    std::random_device rd;
-    std::mt19937       generator(rd());
-    IntDisribution     distribution(0, WEATHER_STATIONS.size() - 1);
+    const auto start_point = std::chrono::system_clock::now();
+    const auto chunk_count = (records + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+    std::atomic<std::size_t> next_chunk    = 0;
+    std::atomic<bool>        failed        = false;
+    std::size_t              next_to_write = 0;
+    std::mutex               mutex;
+    std::condition_variable  turn;
+
+    const auto produce = [&] {
+        NotmalDistibution deviation(0.0f, 10.0f);
+        IntDisribution    distribution(0, stations.size() - 1);
+
+        std::vector<std::uint16_t> station_ids;
+        std::vector<std::int16_t>  temperatures;
+        std::string                buffer;
+        for (auto chunk = next_chunk++; chunk < chunk_count && !failed; chunk = next_chunk++) {
+            std::seed_seq sequence{
+                static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32),
+                static_cast<std::uint32_t>(chunk), static_cast<std::uint32_t>(chunk >> 32)
+            };
+            Generator generator(sequence);
+            deviation.reset();
 
-    auto records_left = records;
-    while (records_left > 0) {
-        const auto chunk_size = std::min(CHUNK_SIZE, records_left);
-        records_left -= chunk_size;
+            station_ids.clear();
+            temperatures.clear();
+            const auto chunk_size = std::min(CHUNK_SIZE, records - chunk * CHUNK_SIZE);
+            for (auto i = 0u; i < chunk_size; ++i) {
+                const auto index = distribution(generator);
+                station_ids.push_back(static_cast<std::uint16_t>(index));
+                temperatures.push_back(static_cast<std::int16_t>(stations[index].measurement(generator, deviation)));
+            }
 
-        for (auto i = 0u; i < chunk_size; ++i) {
-            const auto& station = WEATHER_STATIONS[distribution(generator)];
-            const auto  line    = std::format("{};{:.1f}\n", station.name, station.measurement());
-            outfile.write(line.data(), static_cast<std::streamsize>(line.size()));
+            buffer.clear();
+            if (!binary) {
+                for (auto i = 0u; i < chunk_size; ++i) {
+                    append_measurement(buffer, stations[station_ids[i]].name, temperatures[i]);
+                }
+            }
+
+            std::unique_lock lock(mutex);
+            turn.wait(lock, [&] { return next_to_write == chunk; });
+            if (binary) {
+                for (auto i = 0u; i < chunk_size; ++i) {
+                    binary->append(station_ids[i], temperatures[i]);
+                }
+            } else if (!outfile.write(buffer.data(), static_cast<std::streamsize>(buffer.size()))) {
+                failed = true;
+            }
+            next_to_write++;
+            turn.notify_all();
         }
+    };
+
+    std::vector<std::thread> pool;
+    for (auto i = 0u; i < std::max<std::size_t>(thread_count, 1); ++i) {
+        pool.emplace_back(produce);
+    }
+    for (auto& thread : pool) {
+        thread.join();
     }
 
-    std::cout << format("Created file with {} measurements in {}\n", records, time_past_since(start_point));
+    bool written = false;
+    if (binary) {
+        std::vector<std::string_view> names;
+        for (const auto& station : stations) {
+            names.emplace_back(station.name);
+        }
+        written = binary->finish(names);
+    } else {
+        written = outfile.flush().good();
+    }
+
+    if (failed || !written) {
+        std::cerr << "Failed to write the measurements.\n";
+        return false;
+    }
+
+    std::cout << std::format(
+        "Created file with {} measurements (seed {}) in {}\n", records, seed, time_past_since(start_point)
+    );
+    return true;
 }
 
 int main(int argc, char* argv[]) {
@@ -493,6 +283,15 @@ int main(int argc, char* argv[]) {
     options.add_options()
         ("file", "Result file path", cxxopts::value<std::filesystem::path>())
         ("records", "Number of records to generate", cxxopts::value<std::size_t>()->default_value("1000000000"))
+        ("seed", "Seed of the generated dataset (random when omitted)", cxxopts::value<std::uint64_t>())
+        ("format", "Output format: text or binary", cxxopts::value<std::string>()->default_value("text"))
+        ("stations", "Number of synthetic stations to draw from instead of the built-in list", cxxopts::value<std::size_t>())
+        ("long-names", "Give synthetic stations names of up to 100 bytes", cxxopts::value<bool>()->default_value("false"))
+        ("min-name-length", "Shortest synthetic station name, in bytes", cxxopts::value<std::size_t>()->default_value(std::to_string(MIN_NAME_LENGTH)))
+        ("max-name-length", "Longest synthetic station name, in bytes (at most 100)", cxxopts::value<std::size_t>())
+        ("name-lengths", "Distribution of the synthetic name lengths: uniform or normal", cxxopts::value<std::string>()->default_value("uniform"))
+        ("utf8-names", "Mix multi-byte UTF-8 letters into the synthetic station names", cxxopts::value<bool>()->default_value("false"))
+        ("threads", "Number of generator threads", cxxopts::value<std::size_t>()->default_value(std::to_string(std::thread::hardware_concurrency())))
         ("help", "Print usage")
     ;
     options.parse_positional("file");
@@ -505,7 +304,56 @@ int main(int argc, char* argv[]) {
 
     const auto& filename         = args["file"].as<std::filesystem::path>();
     const auto  records_required = args["records"].as<std::size_t>();
-    generate_measurements(filename, records_required);
+    const auto  thread_count     = args["threads"].as<std::size_t>();
+    const auto  seed             = args.count("seed") ? args["seed"].as<std::uint64_t>() : random_seed();
+
+    const auto& format_name = args["format"].as<std::string>();
+    if (format_name != "text" && format_name != "binary") {
+        std::cerr << std::format("Unknown output format: {}\n", format_name);
+        return 1;
+    }
 
+    std::vector<WeatherStation> synthetic_stations;
+    if (args.count("stations")) {
+        const auto station_count = args["stations"].as<std::size_t>();
+        if (station_count == 0 || station_count > BINARY_MAX_STATIONS) {
+            std::cerr << std::format("The number of stations must be between 1 and {}\n", BINARY_MAX_STATIONS);
+            return 1;
+        }
+
+        NameOptions names;
+        names.min_length = args["min-name-length"].as<std::size_t>();
+        names.max_length = args["long-names"].as<bool>() ? LONG_NAME_LENGTH : SHORT_NAME_LENGTH;
+        if (args.count("max-name-length")) {
+            names.max_length = args["max-name-length"].as<std::size_t>();
+        }
+        names.utf8 = args["utf8-names"].as<bool>();
+        if (names.min_length == 0 || names.min_length > names.max_length || names.max_length > LONG_NAME_LENGTH) {
+            std::cerr << std::format("Name lengths must satisfy 1 <= min <= max <= {}\n", LONG_NAME_LENGTH);
+            return 1;
+        }
+        if (const auto index_length = std::to_string(station_count - 1).size(); names.max_length <= index_length) {
+            std::cerr << std::format(
+                "Names of {} stations end with an index of {} digits, so the longest must be at least {} bytes\n",
+                station_count, index_length, index_length + 1
+            );
+            return 1;
+        }
+
+        const auto& lengths = args["name-lengths"].as<std::string>();
+        if (lengths == "normal") {
+            names.lengths = NameLengths::normal;
+        } else if (lengths != "uniform") {
+            std::cerr << std::format("Unknown name length distribution: {}\n", lengths);
+            return 1;
+        }
+        synthetic_stations = make_synthetic_stations(station_count, names, seed);
+    }
+    const auto& stations = synthetic_stations.empty() ? WEATHER_STATIONS : synthetic_stations;
+
+    const auto output_format = (format_name == "binary") ? OutputFormat::binary : OutputFormat::text;
+    if (!generate_measurements(filename, stations, records_required, seed, thread_count, output_format)) {
+        return 1;
+    }
     return 0;
 }
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "registry.hpp"
+#include "weather-stations.hpp"
+
+
+namespace brc {
+    // Hash-and-displace perfect hash over a key set fixed at compile time.
+    //
+    // Keys are spread over buckets by the high bits of their hash. Buckets are placed largest first: each one gets the
+    // smallest displacement that sends all of its keys to free slots, so a lookup is one bucket read, one slot read and one
+    // key compare, with no probing. Slots map to dense key indices, which lets the records of N keys live in an array of N.
+    // The hash is the one `Hasher` already computes while scanning, so known keys are never hashed twice.
+    template <typename Hasher, std::size_t N>
+    class PerfectHash {
+    public:
+        using hash_type = typename Hasher::hash_type;
+
+        static constexpr std::size_t SLOT_COUNT   = std::bit_ceil(N + N / 8);
+        static constexpr std::size_t BUCKET_COUNT = std::bit_ceil(std::max<std::size_t>(N / 4, 1));
+        static constexpr std::size_t NONE         = N;
+
+        static_assert(N < UINT16_MAX, "slots hold 16-bit key indices");
+
+        consteval explicit PerfectHash(const std::array<std::string_view, N>& keys)
+            : keys_(keys) {
+            std::array<hash_type, N> hashes{};
+            for (std::size_t i = 0; i != N; ++i) {
+                hashes[i] = Hasher{}(keys[i]);
+            }
+
+            std::array<std::size_t, BUCKET_COUNT> bucket_sizes{};
+            for (const auto hash : hashes) {
+                bucket_sizes[bucket(hash)]++;
+            }
+
+            std::array<std::size_t, N> order{};
+            for (std::size_t i = 0; i != N; ++i) {
+                order[i] = i;
+            }
+            std::sort(order.begin(), order.end(), [&](std::size_t lhs, std::size_t rhs) {
+                const auto lhs_bucket = bucket(hashes[lhs]);
+                const auto rhs_bucket = bucket(hashes[rhs]);
+                if (bucket_sizes[lhs_bucket] != bucket_sizes[rhs_bucket]) {
+                    return bucket_sizes[lhs_bucket] > bucket_sizes[rhs_bucket];
+                }
+                return lhs_bucket < rhs_bucket;
+            });
+
+            slots_.fill(static_cast<std::uint16_t>(NONE));
+            for (std::size_t first = 0; first != N;) {
+                const auto current = bucket(hashes[order[first]]);
+                const auto last    = first + bucket_sizes[current];
+
+                std::uint32_t displacement = 0;
+                while (!fits(hashes, order, first, last, displacement)) {
+                    if (++displacement > UINT16_MAX) {
+                        throw "no displacement places the bucket, are two keys equal?";
+                    }
+                }
+
+                displacements_[current] = static_cast<std::uint16_t>(displacement);
+                for (auto i = first; i != last; ++i) {
+                    slots_[slot(hashes[order[i]], displacement)] = static_cast<std::uint16_t>(order[i]);
+                }
+                first = last;
+            }
+        }
+
+        // Index of `key` in the key set, or NONE. `hash` must be what `Hasher` yields for `key`.
+        [[nodiscard]] constexpr std::size_t find(std::string_view key, hash_type hash) const {
+            const std::size_t index = slots_[slot(hash, displacements_[bucket(hash)])];
+            return (index != NONE && keys_[index] == key) ? index : NONE;
+        }
+
+        [[nodiscard]] constexpr std::string_view key(std::size_t index) const {
+            return keys_[index];
+        }
+
+    private:
+        // the top bits of the hash; with a single bucket there are none to take, and shifting by 64 would be undefined
+        [[nodiscard]] static constexpr std::size_t bucket(hash_type hash) {
+            if constexpr (BUCKET_COUNT == 1) {
+                return 0;
+            }
+            return static_cast<std::size_t>(hash >> (64 - std::countr_zero(BUCKET_COUNT))) & (BUCKET_COUNT - 1);
+        }
+
+        [[nodiscard]] static constexpr std::size_t slot(hash_type hash, std::uint32_t displacement) {
+            const std::uint64_t mixed = (hash ^ (displacement * 0x9E3779B97F4A7C15ULL)) * 0xD6E8FEB86659FD93ULL;
+            return static_cast<std::size_t>(mixed >> (64 - std::countr_zero(SLOT_COUNT)));
+        }
+
+        // Whether the keys `order[first, last)` of one bucket land on distinct free slots with `displacement`.
+        [[nodiscard]] constexpr bool fits(
+            const std::array<hash_type, N>&   hashes,
+            const std::array<std::size_t, N>& order,
+            std::size_t                       first,
+            std::size_t                       last,
+            std::uint32_t                     displacement
+        ) const {
+            for (auto i = first; i != last; ++i) {
+                const auto target = slot(hashes[order[i]], displacement);
+                if (slots_[target] != NONE) {
+                    return false;
+                }
+                for (auto j = first; j != i; ++j) {
+                    if (slot(hashes[order[j]], displacement) == target) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        std::array<std::string_view, N>         keys_{};
+        std::array<std::uint16_t, BUCKET_COUNT> displacements_{};
+        std::array<std::uint16_t, SLOT_COUNT>   slots_{};
+    };
+
+    inline constexpr PerfectHash<StationHasher, KNOWN_STATIONS.size()> KNOWN_STATION_HASH([] {
+        std::array<std::string_view, KNOWN_STATIONS.size()> names{};
+        for (std::size_t i = 0; i != names.size(); ++i) {
+            names[i] = KNOWN_STATIONS[i].name;
+        }
+        return names;
+    }());
+
+#if defined(BRC_NO_KNOWN_STATIONS)
+    constexpr bool KNOWN_STATIONS_ENABLED = false;
+#else
+    constexpr bool KNOWN_STATIONS_ENABLED = true;
+#endif
+}  // namespace brc
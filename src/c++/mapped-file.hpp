@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <string_view>
+#include <system_error>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+
+    #define BRC_HAS_MMAP 1
+#endif
+
+
+namespace brc {
+    enum class MapAdvice { none, sequential, willneed };
+
+    // How the kernel should fault in a mapping. Every option is a hint: those the platform lacks are skipped.
+    struct MapOptions {
+        MapAdvice advice     = MapAdvice::none;
+        bool      populate   = false;  // fault the whole file in up front (MAP_POPULATE)
+        bool      huge_pages = false;  // align the mapping to 2 MiB and ask for transparent huge pages
+    };
+
+#if defined(BRC_HAS_MMAP)
+    constexpr bool MMAP_SUPPORTED = true;
+
+    constexpr std::size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+    // Read-only mapping of a whole file, so workers can parse straight out of the page cache without copying lines.
+    class MappedFile {
+    public:
+        explicit MappedFile(const std::filesystem::path& path, const MapOptions& options = {}) {
+            const int descriptor = ::open(path.c_str(), O_RDONLY);
+            if (descriptor == -1) {
+                throw std::system_error(errno, std::generic_category(), std::format("Failed to open {}", path.string()));
+            }
+
+            struct stat info {};
+            if (::fstat(descriptor, &info) == -1) {
+                const int error = errno;
+                ::close(descriptor);
+                throw std::system_error(error, std::generic_category(), std::format("Failed to stat {}", path.string()));
+            }
+
+            size_ = static_cast<std::size_t>(info.st_size);
+            if (size_ != 0) {
+                void* address = map(descriptor, options);
+                if (address == MAP_FAILED) {
+                    const int error = errno;
+                    ::close(descriptor);
+                    throw std::system_error(error, std::generic_category(), std::format("Failed to map {}", path.string()));
+                }
+                data_ = static_cast<const char*>(address);
+                advise(options);
+            }
+
+            // the mapping keeps its own reference to the file
+            ::close(descriptor);
+        }
+
+        MappedFile(const MappedFile&)            = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        ~MappedFile() {
+            if (data_ != nullptr) {
+                ::munmap(const_cast<char*>(data_), size_);
+            }
+        }
+
+        [[nodiscard]] std::string_view view() const {
+            return {data_, size_};
+        }
+
+    private:
+        [[nodiscard]] void* map(int descriptor, const MapOptions& options) const {
+            int flags = MAP_PRIVATE;
+        #if defined(MAP_POPULATE)
+            if (options.populate) {
+                flags |= MAP_POPULATE;
+            }
+        #endif
+            if (!options.huge_pages) {
+                return ::mmap(nullptr, size_, PROT_READ, flags, descriptor, 0);
+            }
+
+            // huge pages need a 2 MiB aligned address: reserve a larger range, map the file over its aligned part and
+            // give back the rest
+            const auto reserved_size = size_ + HUGE_PAGE_SIZE;
+            void*      reserved      = ::mmap(nullptr, reserved_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (reserved == MAP_FAILED) {
+                return MAP_FAILED;
+            }
+
+            const auto start   = reinterpret_cast<std::uintptr_t>(reserved);
+            const auto aligned = (start + HUGE_PAGE_SIZE - 1) & ~(std::uintptr_t{HUGE_PAGE_SIZE} - 1);
+            void*      address =
+                ::mmap(reinterpret_cast<void*>(aligned), size_, PROT_READ, flags | MAP_FIXED, descriptor, 0);
+            if (address == MAP_FAILED) {
+                ::munmap(reserved, reserved_size);
+                return MAP_FAILED;
+            }
+
+            const auto page_size = static_cast<std::uintptr_t>(::sysconf(_SC_PAGESIZE));
+            const auto end       = (aligned + size_ + page_size - 1) & ~(page_size - 1);
+            if (aligned != start) {
+                ::munmap(reserved, aligned - start);
+            }
+            if (end < start + reserved_size) {
+                ::munmap(reinterpret_cast<void*>(end), start + reserved_size - end);
+            }
+            return address;
+        }
+
+        void advise(const MapOptions& options) const {
+            void* address = const_cast<char*>(data_);
+            if (options.advice == MapAdvice::sequential) {
+                ::madvise(address, size_, MADV_SEQUENTIAL);
+            } else if (options.advice == MapAdvice::willneed) {
+                ::madvise(address, size_, MADV_WILLNEED);
+            }
+        #if defined(MADV_HUGEPAGE)
+            // file-backed pages are only collapsed on kernels with read-only THP for file systems
+            if (options.huge_pages) {
+                ::madvise(address, size_, MADV_HUGEPAGE);
+            }
+        #endif
+        }
+
+        const char* data_ = nullptr;
+        std::size_t size_ = 0;
+    };
+#else
+    constexpr bool MMAP_SUPPORTED = false;
+#endif
+}  // namespace brc
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #include <sys/resource.h>
+
+    #define BRC_HAS_RUSAGE 1
+#endif
+
+
+namespace brc {
+    constexpr std::size_t PREFETCH_PAGE_SIZE = 4096;
+    constexpr std::size_t PREFETCH_STEP      = 256 * 1024;  // how far a worker gets before it tells the prefetcher again
+
+    // Touches the pages of a mapped source a fixed distance ahead of every worker, on a thread of its own, so the page
+    // faults (and the disk reads behind them) are taken off the workers' critical path. A worker attaches once and then
+    // reports, every PREFETCH_STEP bytes or so, where it is and where its current segment ends. A distance of zero disables
+    // the prefetcher entirely.
+    class Prefetcher {
+    public:
+        struct alignas(64) Cursor {
+            std::atomic<std::size_t> position = 0;
+            std::atomic<std::size_t> end      = 0;
+
+            void report(std::size_t current, std::size_t segment_end) {
+                end.store(segment_end, std::memory_order_relaxed);
+                position.store(current, std::memory_order_release);
+            }
+        };
+
+        Prefetcher(std::string_view source, std::size_t distance, std::size_t worker_count)
+            : source_(source)
+            , distance_(distance)
+            , cursors_(std::make_unique<Cursor[]>(std::max<std::size_t>(worker_count, 1)))
+            , cursor_count_(std::max<std::size_t>(worker_count, 1)) {
+            if (enabled()) {
+                thread_ = std::thread([this] { run(); });
+            }
+        }
+
+        Prefetcher(const Prefetcher&)            = delete;
+        Prefetcher& operator=(const Prefetcher&) = delete;
+
+        ~Prefetcher() {
+            stop_.store(true, std::memory_order_relaxed);
+            if (thread_.joinable()) {
+                thread_.join();
+            }
+        }
+
+        [[nodiscard]] bool enabled() const {
+            return distance_ != 0 && !source_.empty();
+        }
+
+        // One cursor per worker, at most `worker_count` of them.
+        [[nodiscard]] Cursor& attach() {
+            return cursors_[attached_.fetch_add(1, std::memory_order_relaxed) % cursor_count_];
+        }
+
+    private:
+        void run() {
+            auto                  touched = std::make_unique<std::size_t[]>(cursor_count_);
+            auto                  ends    = std::make_unique<std::size_t[]>(cursor_count_);
+            volatile std::uint8_t sink    = 0;
+            const volatile char*  data    = source_.data();
+
+            while (!stop_.load(std::memory_order_relaxed)) {
+                bool busy = false;
+                for (std::size_t i = 0; i != cursor_count_; ++i) {
+                    const auto position = cursors_[i].position.load(std::memory_order_acquire);
+                    const auto end      = std::min(cursors_[i].end.load(std::memory_order_relaxed), source_.size());
+                    if (end != ends[i]) {
+                        ends[i]    = end;
+                        touched[i] = position;
+                    }
+
+                    const auto from = std::max(touched[i], position) / PREFETCH_PAGE_SIZE * PREFETCH_PAGE_SIZE;
+                    const auto to   = std::min(position + distance_, end);
+                    for (auto page = from; page < to; page += PREFETCH_PAGE_SIZE) {
+                        sink = sink + static_cast<std::uint8_t>(data[page]);
+                        busy = true;
+                    }
+                    touched[i] = std::max(touched[i], to);
+                }
+
+                if (!busy) {
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+                }
+            }
+        }
+
+        std::string_view          source_;
+        std::size_t               distance_;
+        std::unique_ptr<Cursor[]> cursors_;
+        std::size_t               cursor_count_;
+        std::atomic<std::size_t>  attached_ = 0;
+        std::atomic<bool>         stop_     = false;
+        std::thread               thread_;
+    };
+
+    // Calls `process(piece)` on consecutive pieces of `chunk`, each ending on a line break, and reports the progress to
+    // `cursor` before each one. `offset` is where `chunk` starts in the source. Returns the number of pieces.
+    template <typename Process>
+    std::size_t process_prefetched(
+        std::string_view chunk, std::size_t offset, Prefetcher::Cursor& cursor, Process&& process
+    ) {
+        std::size_t pieces = 0;
+        for (std::size_t start = 0; start < chunk.size(); ++pieces) {
+            const auto hint       = std::min(chunk.size(), start + PREFETCH_STEP);
+            const auto line_break = chunk.find('\n', hint - 1);
+            const auto stop       = (line_break == std::string_view::npos) ? chunk.size() : line_break + 1;
+
+            cursor.report(offset + start, offset + chunk.size());
+            process(chunk.substr(start, stop - start));
+            start = stop;
+        }
+        return pieces;
+    }
+
+    struct PageFaults {
+        std::uint64_t minor = 0;  // served from memory, e.g. the page cache
+        std::uint64_t major = 0;  // needed a disk read
+    };
+
+#if defined(BRC_HAS_RUSAGE)
+    constexpr bool FAULT_COUNTS_SUPPORTED = true;
+
+    // Faults taken by the process so far.
+    [[nodiscard]] inline PageFaults page_faults() {
+        rusage usage{};
+        ::getrusage(RUSAGE_SELF, &usage);
+        return {static_cast<std::uint64_t>(usage.ru_minflt), static_cast<std::uint64_t>(usage.ru_majflt)};
+    }
+#else
+    constexpr bool FAULT_COUNTS_SUPPORTED = false;
+
+    [[nodiscard]] inline PageFaults page_faults() {
+        return {};
+    }
+#endif
+}  // namespace brc
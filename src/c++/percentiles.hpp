@@ -0,0 +1,214 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "aggregation.hpp"
+#include "registry.hpp"
+#include "run-stats.hpp"
+#include "station-dictionary.hpp"
+
+
+namespace brc {
+    // Temperatures are tenths of a degree in [-99.9, 99.9], so one counter per possible value makes a histogram exact.
+    constexpr std::int64_t MIN_TEMPERATURE     = -999;
+    constexpr std::int64_t MAX_TEMPERATURE     = 999;
+    constexpr std::size_t  TEMPERATURE_BUCKETS = MAX_TEMPERATURE - MIN_TEMPERATURE + 1;
+
+    struct Percentiles {
+        double median = 0.0;
+        double p95    = 0.0;
+        double p99    = 0.0;
+    };
+
+    using StationPercentiles = std::unordered_map<std::string, Percentiles>;
+
+    [[nodiscard]] constexpr std::size_t temperature_bucket(std::int64_t temperature) {
+        return static_cast<std::size_t>(std::clamp(temperature, MIN_TEMPERATURE, MAX_TEMPERATURE) - MIN_TEMPERATURE);
+    }
+
+    // Nearest-rank percentiles of a histogram holding `count` values: the p-th percentile is the smallest value with at
+    // least p% of the values at or below it, so every result is a temperature that was actually measured.
+    [[nodiscard]] inline Percentiles percentiles_of(std::span<const std::uint64_t> histogram, std::size_t count) {
+        constexpr std::array<std::size_t, 3> PERCENTS = {50, 95, 99};
+
+        std::array<double, 3> values{};
+        std::size_t           target = 0;
+        std::size_t           seen   = 0;
+        for (std::size_t bucket = 0; bucket != histogram.size() && target != PERCENTS.size(); ++bucket) {
+            seen += histogram[bucket];
+            while (target != PERCENTS.size() && seen * 100 >= PERCENTS[target] * count) {
+                values[target++] = static_cast<double>(static_cast<std::int64_t>(bucket) + MIN_TEMPERATURE) * 0.1;
+            }
+        }
+        return {values[0], values[1], values[2]};
+    }
+
+    // One worker's histograms, a row of TEMPERATURE_BUCKETS counters per dictionary id in a single flat array. A row is
+    // contiguous and a station's values cluster around its mean, so the counters a worker keeps hitting share a few cache
+    // lines per station. Counters are a single byte to keep thousands of stations' rows as close to the caches as possible;
+    // every 256th increment of a counter is carried into a sparse map of wide counts.
+    class HistogramTable {
+    public:
+        using Row = std::array<std::uint64_t, TEMPERATURE_BUCKETS>;
+
+        void add(std::uint32_t id, std::int64_t temperature) {
+            const auto row = static_cast<std::size_t>(id) * TEMPERATURE_BUCKETS;
+            if (row + TEMPERATURE_BUCKETS > counts_.size()) {
+                counts_.resize(std::max(row + TEMPERATURE_BUCKETS, 2 * counts_.size()));
+            }
+
+            const auto index = row + temperature_bucket(temperature);
+            if (++counts_[index] == 0) {
+                carries_[index] += 256;
+            }
+        }
+
+        void merge(const HistogramTable& other) {
+            counts_.resize(std::max(counts_.size(), other.counts_.size()));
+            for (std::size_t index = 0; index != other.counts_.size(); ++index) {
+                const unsigned sum = counts_[index] + other.counts_[index];
+                counts_[index]     = static_cast<std::uint8_t>(sum);
+                if (sum > UINT8_MAX) {
+                    carries_[index] += 256;
+                }
+            }
+            for (const auto& [index, carry] : other.carries_) {
+                carries_[index] += carry;
+            }
+        }
+
+        // Full counts of row `id`, all zero if the worker has not seen the id.
+        [[nodiscard]] Row row(std::uint32_t id) const {
+            Row        result{};
+            const auto first = static_cast<std::size_t>(id) * TEMPERATURE_BUCKETS;
+            if (first < counts_.size()) {
+                std::copy_n(counts_.begin() + static_cast<std::ptrdiff_t>(first), TEMPERATURE_BUCKETS, result.begin());
+            }
+            const auto last = carries_.lower_bound(first + TEMPERATURE_BUCKETS);
+            for (auto carry = carries_.lower_bound(first); carry != last; ++carry) {
+                result[carry->first - first] += carry->second;
+            }
+            return result;
+        }
+
+    private:
+        std::vector<std::uint8_t>              counts_;
+        std::map<std::size_t, std::uint64_t> carries_;
+    };
+
+    // A `DenseTable` with a histogram next to every record. Stations the full dictionary refuses get a histogram keyed by
+    // name instead.
+    class PercentileTable {
+    public:
+        explicit PercentileTable(StationDictionary& dictionary)
+            : dictionary_(&dictionary)
+            , records_(dictionary) {}
+
+        void add(std::string_view station, Registry::hash_type hash, std::int64_t temperature) {
+            const auto id = dictionary_->id(station, hash);
+            if (id == StationDictionary::NONE) {
+                records_.add(station, hash, temperature);
+                add_overflow(std::string(station), temperature);
+                return;
+            }
+            records_.add(id, temperature);
+            histograms_.add(id, temperature);
+        }
+
+        void merge(const PercentileTable& other) {
+            records_.merge(other.records_);
+            histograms_.merge(other.histograms_);
+            for (const auto& [station, histogram] : other.overflow_) {
+                auto& counts = overflow_[station];
+                std::transform(histogram.begin(), histogram.end(), counts.begin(), counts.begin(), std::plus<>());
+            }
+        }
+
+        [[nodiscard]] std::size_t size() const {
+            return records_.size();
+        }
+
+        [[nodiscard]] std::size_t capacity() const {
+            return records_.capacity();
+        }
+
+        [[nodiscard]] std::pair<Registry, StationPercentiles> finish() const {
+            auto registry = records_.to_registry();
+
+            StationPercentiles percentiles;
+            percentiles.reserve(registry.size());
+            for (std::uint32_t id = 0; id != dictionary_->size(); ++id) {
+                const auto  station = dictionary_->name(id);
+                const auto* record  = registry.find(station);
+                if (record == nullptr) {
+                    continue;
+                }
+
+                // a name refused while the dictionary filled up can still get an id from another worker
+                auto row = histograms_.row(id);
+                if (const auto spilled = overflow_.find(std::string(station)); spilled != overflow_.end()) {
+                    std::transform(row.begin(), row.end(), spilled->second.begin(), row.begin(), std::plus<>());
+                }
+                percentiles.emplace(station, percentiles_of(row, record->count));
+            }
+            for (const auto& [station, histogram] : overflow_) {
+                percentiles.try_emplace(station, percentiles_of(histogram, registry.find(station)->count));
+            }
+            return {std::move(registry), std::move(percentiles)};
+        }
+
+    private:
+        void add_overflow(std::string station, std::int64_t temperature) {
+            auto& counts = overflow_[std::move(station)];
+            counts[temperature_bucket(temperature)]++;
+        }
+
+        StationDictionary*                                   dictionary_;
+        DenseTable                                           records_;
+        HistogramTable                                       histograms_;
+        std::unordered_map<std::string, HistogramTable::Row> overflow_;
+    };
+
+    // `process_measurements` with exact median, p95 and p99 per station. The workers' tables are merged while the others
+    // are still busy, as usual, histograms included.
+    [[nodiscard]] inline std::pair<Registry, StationPercentiles> process_percentiles(
+        std::string_view source, std::size_t cpu_count, std::size_t segment_size, RunStats* stats = nullptr
+    ) {
+        SegmentQueue      queue = make_segment_queue(source, segment_size, stats);
+        StationDictionary dictionary;
+
+        const auto worker = [&](PercentileTable& table, WorkerStats* worker_stats) {
+            while (const auto segment = queue.next()) {
+                const auto chunk = source.substr(segment->offset, segment->size);
+                if (STATS_SUPPORTED && worker_stats != nullptr) {
+                    process_chunk(chunk, table, *worker_stats);
+                } else {
+                    process_chunk(chunk, table);
+                }
+            }
+        };
+        auto table = run_workers(cpu_count, [&] { return PercentileTable(dictionary); }, worker, stats);
+
+        if (STATS_SUPPORTED && stats != nullptr) {
+            stats->dictionary.emplace().record(dictionary);
+        }
+
+        const auto started = StatsClock::now();
+        auto       result  = table.finish();
+        if (STATS_SUPPORTED && stats != nullptr) {
+            stats->gather += StatsClock::now() - started;
+        }
+        return result;
+    }
+}  // namespace brc
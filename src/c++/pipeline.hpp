@@ -0,0 +1,324 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <latch>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "coroutines.hpp"
+#include "read-ahead.hpp"
+#include "registry.hpp"
+#include "station-dictionary.hpp"
+
+
+namespace brc {
+    constexpr std::size_t DEFAULT_BATCH_SIZE        = 1024;
+    constexpr std::size_t BATCH_PREFETCH_DISTANCE   = 16;  // records between prefetching a slot or a record and using it
+    constexpr std::size_t PIPELINE_BATCHES_PER_TASK = 4;
+
+    // A record the parsers have taken apart: its name, still in the buffer it was read into, the hash the scan computed
+    // for it, and its temperature in tenths.
+    struct ParsedRecord {
+        std::string_view    station;
+        Registry::hash_type hash        = 0;
+        std::int64_t        temperature = 0;
+    };
+
+    // Applies a batch to `table` in three passes over the records, so the cache misses of a batch overlap instead of
+    // following one another. The known stations are numbered first, from KNOWN_STATION_HASH, which stays in cache. The
+    // other names are then looked up in the dictionary, whose slot each record probes first is prefetched
+    // `BATCH_PREFETCH_DISTANCE` records ahead. Last, the records are added with the table row of each id prefetched
+    // as far ahead. `ids` is scratch space, kept by the caller so that a batch does not allocate.
+    inline void apply_batch(
+        std::span<const ParsedRecord> records,
+        DenseTable&                   table,
+        StationDictionary&            dictionary,
+        std::vector<std::uint32_t>&   ids
+    ) {
+        ids.resize(records.size());
+        for (std::size_t i = 0; i != records.size(); ++i) {
+            ids[i] = StationDictionary::known_id(records[i].station, records[i].hash);
+        }
+
+        for (std::size_t i = 0; i != std::min(records.size(), BATCH_PREFETCH_DISTANCE); ++i) {
+            if (ids[i] == StationDictionary::NONE) {
+                dictionary.prefetch(records[i].hash);
+            }
+        }
+        for (std::size_t i = 0; i != records.size(); ++i) {
+            const auto ahead = i + BATCH_PREFETCH_DISTANCE;
+            if (ahead < records.size() && ids[ahead] == StationDictionary::NONE) {
+                dictionary.prefetch(records[ahead].hash);
+            }
+            if (ids[i] == StationDictionary::NONE) {
+                ids[i] = dictionary.find_or_insert(records[i].station, records[i].hash);
+            }
+        }
+
+        for (std::size_t i = 0; i != std::min(records.size(), BATCH_PREFETCH_DISTANCE); ++i) {
+            table.prefetch(ids[i]);
+        }
+        for (std::size_t i = 0; i != records.size(); ++i) {
+            if (i + BATCH_PREFETCH_DISTANCE < records.size()) {
+                table.prefetch(ids[i + BATCH_PREFETCH_DISTANCE]);
+            }
+            if (ids[i] == StationDictionary::NONE) {
+                table.add(records[i].station, records[i].hash, records[i].temperature);  // the dictionary is full
+            } else {
+                table.add(ids[i], records[i].temperature);
+            }
+        }
+    }
+
+#if defined(BRC_HAS_PREAD)
+    constexpr bool PIPELINE_SUPPORTED = true;
+
+    // Aggregates a file in three stages of coroutines sharing one thread pool: readers fill buffers with `pread`, parsers
+    // cut the buffers into batches of parsed records, and aggregators apply the batches to their dense tables. The stages
+    // hand their work over through bounded channels, so a stage that runs ahead suspends rather than queueing without
+    // limit, and a coroutine waiting on a channel leaves its thread to the other stages. The number of tasks of every stage
+    // is set on its own.
+    //
+    // Blocks are cut like those of `process_read_ahead`, with the same margins. A buffer goes back to the readers once the
+    // last batch pointing into it is applied.
+    class Pipeline {
+    public:
+        struct Options {
+            std::size_t reader_count     = DEFAULT_READER_COUNT;
+            std::size_t parser_count     = 1;
+            std::size_t aggregator_count = 1;
+            std::size_t block_size       = 0;
+            std::size_t batch_size       = DEFAULT_BATCH_SIZE;
+            bool        direct_io        = false;
+        };
+
+        // All stages share one pool, which has a thread per reader on top of `cpu_count`: a reader blocks the thread it
+        // runs on for as long as `pread` takes, and the extra threads leave `cpu_count` of them to the other stages even
+        // while every reader is blocked. Readers are not bound to the extra threads; any task may run on any thread.
+        Pipeline(const std::filesystem::path& source_path, std::size_t cpu_count, const Options& options)
+            : options_(options)
+            , file_(source_path, options.direct_io)
+            , block_size_(std::max(options.block_size / READ_AHEAD_ALIGNMENT, std::size_t{1}) * READ_AHEAD_ALIGNMENT)
+            , buffer_size_(block_size_ + 2 * READ_AHEAD_ALIGNMENT)
+            , block_count_((file_.size() + block_size_ - 1) / block_size_)
+            , buffer_count_(options.parser_count + 2 * options.reader_count)
+            , batch_count_((options.parser_count + options.aggregator_count) * PIPELINE_BATCHES_PER_TASK)
+            , buffers_(std::make_unique<Buffer[]>(buffer_count_))
+            , batches_(std::make_unique<Batch[]>(batch_count_))
+            , storage_(std::make_unique_for_overwrite<char[]>(buffer_count_ * buffer_size_ + READ_AHEAD_ALIGNMENT))
+            , tables_(options.aggregator_count, DenseTable(dictionary_))
+            , done_(static_cast<std::ptrdiff_t>(options.reader_count + options.parser_count + options.aggregator_count))
+            , pool_(cpu_count + options.reader_count)
+            , free_buffers_(pool_, buffer_count_)
+            , filled_buffers_(pool_, buffer_count_, options.reader_count)
+            , free_batches_(pool_, batch_count_)
+            , filled_batches_(pool_, batch_count_, options.parser_count) {
+            void*       aligned = storage_.get();
+            std::size_t space   = buffer_count_ * buffer_size_ + READ_AHEAD_ALIGNMENT;
+            aligned             = std::align(READ_AHEAD_ALIGNMENT, buffer_count_ * buffer_size_, aligned, space);
+
+            for (std::size_t i = 0; i != buffer_count_; ++i) {
+                buffers_[i].data = static_cast<char*>(aligned) + i * buffer_size_;
+                static_cast<void>(free_buffers_.try_push(&buffers_[i]));
+            }
+            for (std::size_t i = 0; i != batch_count_; ++i) {
+                batches_[i].records.reserve(options_.batch_size);
+                static_cast<void>(free_batches_.try_push(&batches_[i]));
+            }
+        }
+
+        // Empty if a record is longer than the margin around the blocks.
+        [[nodiscard]] std::optional<Registry> run() {
+            for (std::size_t i = 0; i != options_.reader_count; ++i) {
+                read();
+            }
+            for (std::size_t i = 0; i != options_.parser_count; ++i) {
+                parse();
+            }
+            for (auto& table : tables_) {
+                aggregate(table);
+            }
+            done_.wait();
+
+            if (read_error_) {
+                std::rethrow_exception(read_error_);
+            }
+            if (failed_) {
+                return std::nullopt;
+            }
+
+            for (std::size_t i = 1; i < tables_.size(); ++i) {
+                tables_.front().merge(tables_[i]);
+            }
+            return tables_.front().to_registry();
+        }
+
+    private:
+        struct Buffer {
+            char*                    data       = nullptr;
+            std::size_t              size       = 0;
+            std::size_t              index      = 0;
+            std::atomic<std::size_t> references = 0;  // the parser's, and one per batch not yet applied
+
+            [[nodiscard]] std::string_view view() const {
+                return {data, size};
+            }
+        };
+
+        struct Batch {
+            Buffer*                   buffer = nullptr;
+            std::vector<ParsedRecord> records;
+        };
+
+        DetachedTask read() {
+            co_await pool_.schedule();
+            try {
+                for (auto index = next_block_++; index < block_count_ && !failed_; index = next_block_++) {
+                    Buffer* buffer = *co_await free_buffers_.pop();
+
+                    const auto base = (index == 0) ? 0 : index * block_size_ - READ_AHEAD_ALIGNMENT;
+                    buffer->index   = index;
+                    buffer->size    = file_.read(buffer->data, buffer_size_, base);
+                    co_await filled_buffers_.push(buffer);
+                }
+            } catch (...) {
+                std::lock_guard lock(read_error_mutex_);
+                read_error_ = std::current_exception();
+                failed_     = true;
+            }
+
+            filled_buffers_.close();
+            done_.count_down();
+        }
+
+        DetachedTask parse() {
+            co_await pool_.schedule();
+            while (true) {
+                const auto filled = co_await filled_buffers_.pop();
+                if (!filled) {
+                    break;
+                }
+
+                Buffer* buffer     = *filled;
+                buffer->references = 1;
+
+                const auto offset = buffer->index * block_size_;
+                const auto base   = (buffer->index == 0) ? 0 : offset - READ_AHEAD_ALIGNMENT;
+                const auto first  = record_start(buffer->view(), base, offset, file_.size());
+                const auto last   = record_start(buffer->view(), base, offset + block_size_, file_.size());
+                if (!first || !last) {
+                    failed_ = true;
+                } else if (*first < *last) {
+                    const char*       cursor = buffer->data + (*first - base);
+                    const char* const end    = buffer->data + (*last - base);
+
+                    Batch* batch = nullptr;
+                    while (cursor < end) {
+                        if (batch == nullptr) {
+                            batch         = *co_await free_batches_.pop();
+                            batch->buffer = buffer;
+                            batch->records.clear();
+                            buffer->references++;
+                        }
+
+                        const auto [delimiter, hash] = Registry::hasher_type::scan(cursor, end);
+                        const auto temperature       = decode_temperature(load_word(delimiter + 1, end));
+                        batch->records.push_back({std::string_view{cursor, delimiter}, hash, temperature.value});
+                        cursor = delimiter + temperature.length + 2;
+
+                        if (batch->records.size() == options_.batch_size) {
+                            co_await filled_batches_.push(batch);
+                            batch = nullptr;
+                        }
+                    }
+                    if (batch != nullptr) {
+                        co_await filled_batches_.push(batch);
+                    }
+                }
+
+                if (--buffer->references == 0) {
+                    co_await free_buffers_.push(buffer);
+                }
+            }
+
+            filled_batches_.close();
+            done_.count_down();
+        }
+
+        DetachedTask aggregate(DenseTable& table) {
+            co_await pool_.schedule();
+
+            std::vector<std::uint32_t> ids;
+            while (true) {
+                const auto filled = co_await filled_batches_.pop();
+                if (!filled) {
+                    break;
+                }
+
+                Batch*  batch  = *filled;
+                Buffer* buffer = batch->buffer;
+                apply_batch(batch->records, table, dictionary_, ids);
+
+                co_await free_batches_.push(batch);
+                if (--buffer->references == 0) {
+                    co_await free_buffers_.push(buffer);
+                }
+            }
+
+            done_.count_down();
+        }
+
+        Options                   options_;
+        const PositionalFile      file_;
+        std::size_t               block_size_;
+        std::size_t               buffer_size_;
+        std::size_t               block_count_;
+        std::size_t               buffer_count_;
+        std::size_t               batch_count_;
+        std::unique_ptr<Buffer[]> buffers_;
+        std::unique_ptr<Batch[]>  batches_;
+        std::unique_ptr<char[]>   storage_;
+        StationDictionary         dictionary_;
+        std::vector<DenseTable>   tables_;
+        std::atomic<std::size_t>  next_block_ = 0;
+        std::atomic<bool>         failed_     = false;
+        std::exception_ptr        read_error_;
+        std::mutex                read_error_mutex_;
+        std::latch                done_;
+
+        // The channels post to the pool, so they come after it; by the time they are destroyed, every task is done with
+        // them, and the pool is joined right after, before anything above goes away.
+        ThreadPool       pool_;
+        Channel<Buffer*> free_buffers_;
+        Channel<Buffer*> filled_buffers_;
+        Channel<Batch*>  free_batches_;
+        Channel<Batch*>  filled_batches_;
+    };
+
+    // Aggregates `source_path` through a `Pipeline` on `cpu_count` threads. Parser and aggregator counts of 0 mean one
+    // task per thread.
+    [[nodiscard]] inline std::optional<Registry> process_pipelined(
+        const std::filesystem::path& source_path, std::size_t cpu_count, Pipeline::Options options
+    ) {
+        cpu_count                = std::max<std::size_t>(cpu_count, 1);
+        options.reader_count     = std::max<std::size_t>(options.reader_count, 1);
+        options.parser_count     = (options.parser_count == 0) ? cpu_count : options.parser_count;
+        options.aggregator_count = (options.aggregator_count == 0) ? cpu_count : options.aggregator_count;
+        options.batch_size       = std::max<std::size_t>(options.batch_size, 1);
+
+        Pipeline pipeline(source_path, cpu_count, options);
+        return pipeline.run();
+    }
+#else
+    constexpr bool PIPELINE_SUPPORTED = false;
+#endif
+}  // namespace brc
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "aggregation.hpp"
+#include "registry.hpp"
+#include "run-stats.hpp"
+#include "station-dictionary.hpp"
+
+
+namespace brc {
+    // Exact station names, matched by the hash the scan already computed for the row, so a row that does not match costs
+    // one probe and no allocation.
+    class StationSet {
+    public:
+        StationSet() = default;
+
+        explicit StationSet(const std::vector<std::string>& names)
+            : slots_(std::bit_ceil(2 * std::max<std::size_t>(names.size(), 1)))
+            , mask_(slots_.size() - 1) {
+            const Registry::hasher_type hasher;
+            for (const auto& name : names) {
+                if (!contains(name, hasher(name))) {
+                    std::size_t index = hasher(name) & mask_;
+                    while (slots_[index].second) {
+                        index = (index + 1) & mask_;
+                    }
+                    slots_[index] = {hasher(name), name};
+                }
+            }
+        }
+
+        [[nodiscard]] bool empty() const {
+            return slots_.empty();
+        }
+
+        [[nodiscard]] bool contains(std::string_view station, Registry::hash_type hash) const {
+            for (std::size_t index = hash & mask_;; index = (index + 1) & mask_) {
+                const auto& [slot_hash, name] = slots_[index];
+                if (!name) {
+                    return false;
+                }
+                if (slot_hash == hash && *name == station) {
+                    return true;
+                }
+            }
+        }
+
+    private:
+        std::vector<std::pair<Registry::hash_type, std::optional<std::string>>> slots_;
+        std::size_t                                                               mask_ = 0;
+    };
+
+    // Which rows a query aggregates: readings within `[min_temperature, max_temperature]` of the listed stations, or of
+    // every station when none are listed. Temperatures are in tenths, like the records.
+    struct RowFilter {
+        std::int64_t             min_temperature = std::numeric_limits<std::int64_t>::min();
+        std::int64_t             max_temperature = std::numeric_limits<std::int64_t>::max();
+        StationSet               stations;
+        std::vector<std::string> prefixes;
+
+        // `list` holds names separated by ';', which never occurs in a name; a name ending in '*' is a prefix. False if it
+        // holds neither, as an empty list would filter nothing.
+        [[nodiscard]] bool set_stations(std::string_view list) {
+            std::vector<std::string> names;
+            while (!list.empty()) {
+                const auto separator = std::min(list.find(';'), list.size());
+                const auto entry     = list.substr(0, separator);
+                list.remove_prefix(std::min(separator + 1, list.size()));
+
+                if (entry.ends_with('*')) {
+                    prefixes.emplace_back(entry.substr(0, entry.size() - 1));
+                } else if (!entry.empty()) {
+                    names.emplace_back(entry);
+                }
+            }
+            stations = StationSet(names);
+            return !names.empty() || !prefixes.empty();
+        }
+
+        // The temperature is tested first, as it is the cheapest test.
+        [[nodiscard]] bool accepts(std::string_view station, Registry::hash_type hash, std::int64_t temperature) const {
+            if (temperature < min_temperature || temperature > max_temperature) {
+                return false;
+            }
+            if (stations.empty() && prefixes.empty()) {
+                return true;
+            }
+            if (!stations.empty() && stations.contains(station, hash)) {
+                return true;
+            }
+            return std::any_of(prefixes.begin(), prefixes.end(), [station](const std::string& prefix) {
+                return station.starts_with(prefix);
+            });
+        }
+    };
+
+    // The scan loop of `process_chunk` with the filter pushed down: a rejected row never reaches the table.
+    template <typename Table>
+    void process_chunk(std::string_view chunk, Table& table, const RowFilter& filter) {
+        const char*       cursor = chunk.data();
+        const char* const end    = cursor + chunk.size();
+        while (cursor < end) {
+            const auto [delimiter, hash] = Registry::hasher_type::scan(cursor, end);
+
+            const auto station     = std::string_view{cursor, delimiter};
+            const auto temperature = decode_temperature(load_word(delimiter + 1, end));
+            if (filter.accepts(station, hash, temperature.value)) {
+                table.add(station, hash, temperature.value);
+            }
+
+            cursor = delimiter + temperature.length + 2;
+        }
+    }
+
+    // Aggregates the rows of `source` that `filter` accepts, the way `process_measurements` aggregates all of them.
+    [[nodiscard]] inline Registry process_query(
+        std::string_view source, std::size_t cpu_count, std::size_t segment_size, const RowFilter& filter
+    ) {
+        SegmentQueue      queue = make_segment_queue(source, segment_size, nullptr);
+        StationDictionary dictionary;
+
+        const auto worker = [&](DenseTable& table, WorkerStats*) {
+            while (const auto segment = queue.next()) {
+                process_chunk(source.substr(segment->offset, segment->size), table, filter);
+            }
+        };
+        return run_workers(cpu_count, [&] { return DenseTable(dictionary); }, worker).to_registry();
+    }
+
+    enum class RankKey { mean, max, min, count };
+
+    using RankedStation = std::pair<std::string_view, Stats>;
+
+    // The `k` stations with the highest `key`, highest first; ties go to the name that sorts first. A heap of `k` entries
+    // is kept while the registry is walked once, so only the winners are ever sorted.
+    [[nodiscard]] inline std::vector<RankedStation> top_stations(const Registry& registry, std::size_t k, RankKey key) {
+        const auto value = [key](const Stats& stats) -> double {
+            switch (key) {
+                case RankKey::mean:
+                    return static_cast<double>(stats.sum) / static_cast<double>(stats.count);
+                case RankKey::max:
+                    return stats.max;
+                case RankKey::min:
+                    return stats.min;
+                case RankKey::count:
+                    return static_cast<double>(stats.count);
+            }
+            return 0.0;
+        };
+        const auto ranks_higher = [&value](const RankedStation& lhs, const RankedStation& rhs) {
+            const auto lhs_value = value(lhs.second);
+            const auto rhs_value = value(rhs.second);
+            return lhs_value > rhs_value || (lhs_value == rhs_value && lhs.first < rhs.first);
+        };
+
+        // with `ranks_higher` as the order, the front of the heap is the lowest ranked entry kept so far
+        std::vector<RankedStation> heap;
+        heap.reserve(std::min(k, registry.size()));
+        for (const auto& [station, stats] : registry) {
+            const RankedStation entry{station, stats};
+            if (heap.size() < k) {
+                heap.push_back(entry);
+                std::push_heap(heap.begin(), heap.end(), ranks_higher);
+            } else if (k != 0 && ranks_higher(entry, heap.front())) {
+                std::pop_heap(heap.begin(), heap.end(), ranks_higher);
+                heap.back() = entry;
+                std::push_heap(heap.begin(), heap.end(), ranks_higher);
+            }
+        }
+        std::sort_heap(heap.begin(), heap.end(), ranks_higher);
+        return heap;
+    }
+}  // namespace brc
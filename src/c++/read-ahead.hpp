@@ -0,0 +1,220 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <exception>
+#include <filesystem>
+#include <format>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "aggregation.hpp"
+#include "registry.hpp"
+#include "run-stats.hpp"
+#include "station-dictionary.hpp"
+#include "streaming.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+    #include <fcntl.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+
+    #define BRC_HAS_PREAD 1
+#endif
+
+
+namespace brc {
+    constexpr std::size_t DEFAULT_READER_COUNT = 2;
+
+#if defined(BRC_HAS_PREAD)
+    constexpr bool READ_AHEAD_SUPPORTED = true;
+
+        #if defined(O_DIRECT)
+    constexpr bool DIRECT_IO_SUPPORTED = true;
+        #else
+    constexpr bool DIRECT_IO_SUPPORTED = false;
+        #endif
+
+    // Block reads are aligned to this, as O_DIRECT wants on every common file system. A block is read together with this
+    // much of the source on either side: the byte before tells whether the block starts on a record, the bytes after
+    // finish its last record.
+    constexpr std::size_t READ_AHEAD_ALIGNMENT = 4096;
+
+    // A file read with positioned reads, which any number of threads may issue at once.
+    class PositionalFile {
+    public:
+        PositionalFile(const std::filesystem::path& path, bool direct_io) {
+            int flags = O_RDONLY;
+        #if defined(O_DIRECT)
+            if (direct_io) {
+                flags |= O_DIRECT;
+            }
+        #endif
+
+            descriptor_ = ::open(path.c_str(), flags);
+            if (descriptor_ == -1) {
+                throw std::system_error(errno, std::generic_category(), std::format("Failed to open {}", path.string()));
+            }
+
+            struct stat info {};
+            if (::fstat(descriptor_, &info) == -1) {
+                const int error = errno;
+                ::close(descriptor_);
+                throw std::system_error(error, std::generic_category(), std::format("Failed to stat {}", path.string()));
+            }
+            size_ = static_cast<std::size_t>(info.st_size);
+        }
+
+        PositionalFile(const PositionalFile&)            = delete;
+        PositionalFile& operator=(const PositionalFile&) = delete;
+
+        ~PositionalFile() {
+            ::close(descriptor_);
+        }
+
+        [[nodiscard]] std::size_t size() const {
+            return size_;
+        }
+
+        // Reads until `size` bytes are in or the file ends; returns the number of bytes read.
+        [[nodiscard]] std::size_t read(char* buffer, std::size_t size, std::size_t offset) const {
+            std::size_t done = 0;
+            while (done != size) {
+                const auto result = ::pread(descriptor_, buffer + done, size - done, static_cast<off_t>(offset + done));
+                if (result == -1 && errno == EINTR) {
+                    continue;
+                }
+                if (result == -1) {
+                    throw std::system_error(errno, std::generic_category(), "Failed to read the source");
+                }
+                if (result == 0) {
+                    break;
+                }
+                done += static_cast<std::size_t>(result);
+            }
+            return done;
+        }
+
+    private:
+        int         descriptor_ = -1;
+        std::size_t size_       = 0;
+    };
+
+    // Where the record at or after `position` starts, in a block read from `base`: a record starts right after a line
+    // break. Null if no line break follows within the block and the block does not reach the end of the file.
+    [[nodiscard]] inline std::optional<std::size_t> record_start(
+        std::string_view block, std::size_t base, std::size_t position, std::size_t file_size
+    ) {
+        if (position == 0 || position >= file_size) {
+            return std::min(position, file_size);
+        }
+
+        const auto line_break = block.find('\n', position - 1 - base);
+        if (line_break == std::string_view::npos) {
+            return (base + block.size() == file_size) ? std::optional(file_size) : std::nullopt;
+        }
+        return base + line_break + 1;
+    }
+
+    // Aggregates a file too large for the page cache, or cold on disk, without stalling the parsers on it. `reader_count`
+    // threads read fixed blocks of the file with `pread` into a pool of reusable, aligned buffers, optionally bypassing the
+    // page cache with O_DIRECT, while `cpu_count` parsers aggregate the blocks already read in whatever order they arrive.
+    // Block `i` owns the records starting in `[i * block_size, (i + 1) * block_size)`, which it finds on its own thanks to
+    // the margins read around it, so readers never wait for one another. Memory stays at one buffer per parser and two per
+    // reader. Empty if a record is longer than the margin.
+    [[nodiscard]] inline std::optional<Registry> process_read_ahead(
+        const std::filesystem::path& source_path,
+        std::size_t                  cpu_count,
+        std::size_t                  block_size,
+        std::size_t                  reader_count,
+        bool                         direct_io,
+        RunStats*                    stats = nullptr
+    ) {
+        cpu_count    = std::max<std::size_t>(cpu_count, 1);
+        reader_count = std::max<std::size_t>(reader_count, 1);
+        block_size   = std::max(block_size / READ_AHEAD_ALIGNMENT, std::size_t{1}) * READ_AHEAD_ALIGNMENT;
+
+        const PositionalFile file(source_path, direct_io);
+        const auto           block_count = (file.size() + block_size - 1) / block_size;
+        const auto           buffer_size = block_size + 2 * READ_AHEAD_ALIGNMENT;
+
+        BlockPool                pool(cpu_count + 2 * reader_count, buffer_size, READ_AHEAD_ALIGNMENT);
+        StationDictionary        dictionary;
+        std::atomic<std::size_t> next_block     = 0;
+        std::atomic<std::size_t> active_readers = reader_count;
+        std::atomic<bool>        failed         = false;
+        std::exception_ptr       read_error;
+        std::mutex               read_error_mutex;
+
+        std::vector<std::thread> readers;
+        for (std::size_t i = 0; i != reader_count; ++i) {
+            readers.emplace_back([&] {
+                try {
+                    for (auto index = next_block++; index < block_count && !failed; index = next_block++) {
+                        BlockPool::Block* block = pool.acquire_free();
+
+                        const auto base = (index == 0) ? 0 : index * block_size - READ_AHEAD_ALIGNMENT;
+                        block->index    = index;
+                        block->size     = file.read(block->data, buffer_size, base);
+                        pool.publish(block);
+                    }
+                } catch (...) {
+                    std::lock_guard lock(read_error_mutex);
+                    read_error = std::current_exception();
+                    failed     = true;
+                }
+
+                if (--active_readers == 0) {
+                    pool.close();
+                }
+            });
+        }
+
+        const auto worker = [&](DenseTable& table, WorkerStats* worker_stats) {
+            while (BlockPool::Block* block = pool.acquire_filled()) {
+                const auto offset = block->index * block_size;
+                const auto base   = (block->index == 0) ? 0 : offset - READ_AHEAD_ALIGNMENT;
+                const auto first  = record_start(block->view(), base, offset, file.size());
+                const auto last   = record_start(block->view(), base, offset + block_size, file.size());
+
+                if (!first || !last) {
+                    failed = true;
+                } else if (*first < *last) {
+                    const auto chunk = block->view().substr(*first - base, *last - *first);
+                    if (STATS_SUPPORTED && worker_stats != nullptr) {
+                        process_chunk(chunk, table, *worker_stats);
+                    } else {
+                        process_chunk(chunk, table);
+                    }
+                }
+                pool.release(block);
+            }
+        };
+        const auto table = run_workers(cpu_count, [&] { return DenseTable(dictionary); }, worker, stats);
+
+        for (auto& reader : readers) {
+            reader.join();
+        }
+        if (read_error) {
+            std::rethrow_exception(read_error);
+        }
+        if (failed) {
+            return std::nullopt;
+        }
+
+        if (STATS_SUPPORTED && stats != nullptr) {
+            stats->dictionary.emplace().record(dictionary);
+        }
+        return table.to_registry();
+    }
+#else
+    constexpr bool READ_AHEAD_SUPPORTED = false;
+    constexpr bool DIRECT_IO_SUPPORTED  = false;
+#endif
+}  // namespace brc
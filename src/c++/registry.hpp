@@ -0,0 +1,495 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <istream>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "scanning.hpp"
+
+
+namespace brc {
+    // Temperatures are fixed-point tenths in [-999, 999], so 32-bit bounds keep the record at 24 bytes.
+    struct Stats {
+        std::int32_t min   = std::numeric_limits<std::int32_t>::max();
+        std::int32_t max   = std::numeric_limits<std::int32_t>::min();
+        std::int64_t sum   = 0;
+        std::size_t  count = 0;
+
+        Stats() = default;
+        Stats(std::int64_t temperature)
+            : min(static_cast<std::int32_t>(temperature))
+            , max(static_cast<std::int32_t>(temperature))
+            , sum(temperature)
+            , count(1) {}
+
+        void add(std::int64_t temperature) {
+            min = std::min(min, static_cast<std::int32_t>(temperature));
+            max = std::max(max, static_cast<std::int32_t>(temperature));
+            sum += temperature;
+            count++;
+        }
+
+        void merge(const Stats& other) {
+            min = std::min(min, other.min);
+            max = std::max(max, other.max);
+            sum += other.sum;
+            count += other.count;
+        }
+
+        [[nodiscard]] double minimum() const {
+            return min * 0.1;
+        }
+
+        [[nodiscard]] double maximum() const {
+            return max * 0.1;
+        }
+
+        [[nodiscard]] double mean() const {
+            if (count == 0) {
+                return 0.0;
+            }
+
+            return sum / static_cast<double>(count) * 0.1;
+        }
+    };
+
+    // A station name located in the input together with the hash of its bytes.
+    struct ScannedStation {
+        const char* delimiter;  // the ';' that ends the name
+        std::size_t hash;
+    };
+
+    class StringHasher {
+    public:
+        using hash_type      = std::size_t;
+        using is_transparent = void;
+
+        static constexpr hash_type FNV_offset_basis = 14695981039346656037ULL;
+        static constexpr hash_type FNV_prime        = 1099511628211ULL;
+
+        hash_type operator()(const char* str) const {
+            return fnv1a_hash(str);
+        }
+
+        constexpr hash_type operator()(std::string_view str) const {
+            return fnv1a_hash(str);
+        }
+
+        hash_type operator()(const std::string& str) const {
+            return fnv1a_hash(str);
+        }
+
+        [[nodiscard]] static ScannedStation scan(const char* begin, const char* end) {
+            const char* delimiter = find_byte(begin, end, ';');
+            return {delimiter, fnv1a_hash({begin, delimiter})};
+        }
+
+    private:
+        static constexpr hash_type fnv1a_hash(std::string_view str) {
+            hash_type hash = FNV_offset_basis;
+            for (const unsigned char c : str) {
+                hash ^= c;
+                hash *= FNV_prime;
+            }
+            return hash;
+        }
+    };
+
+    // Hashes 8 bytes per multiplication (FxHash-style rotate/xor/multiply); the last partial word is zero-padded. The
+    // same value is produced by `scan`, which builds the hash while it searches for the ';' that ends the station name,
+    // so locating a key and hashing it take a single pass over its bytes.
+    class WordHasher {
+    public:
+        using hash_type      = std::size_t;
+        using is_transparent = void;
+
+        static constexpr std::uint64_t MULTIPLIER = 0x517CC1B727220A95ULL;
+
+        hash_type operator()(const char* str) const {
+            return word_hash(str);
+        }
+
+        constexpr hash_type operator()(std::string_view str) const {
+            return word_hash(str);
+        }
+
+        hash_type operator()(const std::string& str) const {
+            return word_hash(str);
+        }
+
+        [[nodiscard]] static ScannedStation scan(const char* begin, const char* end) {
+            constexpr std::uint64_t delimiters = SWAR_ONES * ';';
+
+            hash_type hash = 0;
+            for (const char* cursor = begin; cursor < end; cursor += sizeof(std::uint64_t)) {
+                const std::uint64_t word  = load_word(cursor, end);
+                const std::uint64_t match = match_bytes(word, delimiters);
+                if (match != 0) {
+                    const std::uint64_t below = (match ^ (match - 1)) >> 8;  // the bytes in front of the ';'
+                    return {cursor + std::countr_zero(match) / 8, finish(mix(hash, word & below))};
+                }
+                hash = mix(hash, word);
+            }
+            return {end, finish(hash)};
+        }
+
+    private:
+        [[nodiscard]] static constexpr hash_type mix(hash_type hash, std::uint64_t word) {
+            return (std::rotl(hash, 5) ^ word) * MULTIPLIER;
+        }
+
+        // the table index is taken from the low bits, which a multiplication alone leaves poorly mixed
+        [[nodiscard]] static constexpr hash_type finish(hash_type hash) {
+            return hash ^ (hash >> 32);
+        }
+
+        static constexpr hash_type word_hash(std::string_view str) {
+            const char* const end    = str.data() + str.size();
+            const char*       cursor = str.data();
+
+            hash_type hash = 0;
+            for (; end - cursor >= static_cast<std::ptrdiff_t>(sizeof(std::uint64_t)); cursor += sizeof(std::uint64_t)) {
+                hash = mix(hash, load_word(cursor, end));
+            }
+            return finish(mix(hash, load_word(cursor, end)));
+        }
+    };
+
+#if defined(BRC_FNV1A_HASH)
+    using StationHasher = StringHasher;
+#else
+    using StationHasher = WordHasher;
+#endif
+
+    // Open-addressing table of per-station records.
+    //
+    // Slots live in a single power-of-two array probed linearly. Each slot keeps the full hash of its key next to a compact
+    // `Stats`, so almost every mismatch is rejected without touching the key bytes, and the keys themselves are appended
+    // to one arena owned by the table. A slot is empty while its `count` is zero. With the default capacity the 413 known
+    // stations occupy ~40 KB of slots, which stays inside L2.
+    template <typename Hasher>
+    class BasicRegistry {
+    public:
+        using hasher_type = Hasher;
+        using hash_type   = typename Hasher::hash_type;
+
+        static constexpr std::size_t DEFAULT_CAPACITY = 1024;
+
+        class Iterator {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using difference_type   = std::ptrdiff_t;
+            using value_type        = std::pair<std::string_view, const Stats&>;
+            using pointer           = void;
+            using reference         = value_type;
+
+            Iterator(const BasicRegistry& registry, std::size_t index)
+                : registry_(&registry)
+                , index_(index) {
+                skip_empty();
+            }
+
+            [[nodiscard]] value_type operator*() const {
+                const auto& slot = registry_->slots_[index_];
+                return {registry_->key_of(slot), slot.stats};
+            }
+
+            Iterator& operator++() {
+                ++index_;
+                skip_empty();
+                return *this;
+            }
+
+            [[nodiscard]] bool operator==(const Iterator& other) const = default;
+
+        private:
+            void skip_empty() {
+                while (index_ < registry_->slots_.size() && registry_->slots_[index_].stats.count == 0) {
+                    ++index_;
+                }
+            }
+
+            const BasicRegistry* registry_;
+            std::size_t          index_;
+        };
+
+        explicit BasicRegistry(std::size_t capacity = DEFAULT_CAPACITY)
+            : slots_(std::bit_ceil(std::max<std::size_t>(capacity, 2)))
+            , mask_(slots_.size() - 1) {}
+
+        [[nodiscard]] Iterator begin() const {
+            return {*this, 0};
+        }
+
+        [[nodiscard]] Iterator end() const {
+            return {*this, slots_.size()};
+        }
+
+        [[nodiscard]] std::size_t size() const {
+            return size_;
+        }
+
+        [[nodiscard]] bool empty() const {
+            return size_ == 0;
+        }
+
+        [[nodiscard]] const Stats* find(std::string_view station) const {
+            const Slot& slot = slots_[probe(station, hasher_(station))];
+            return (slot.stats.count != 0) ? &slot.stats : nullptr;
+        }
+
+        void add(std::string_view station, std::int64_t temperature) {
+            add(station, hasher_(station), temperature);
+        }
+
+        // `hash` must be what `Hasher` yields for `station`, e.g. as produced by `Hasher::scan`
+        void add(std::string_view station, hash_type hash, std::int64_t temperature) {
+            upsert(station, hash, [temperature](Stats& stats) { stats.add(temperature); }, Stats(temperature));
+        }
+
+        void merge(std::string_view station, const Stats& stats) {
+            upsert(station, hasher_(station), [&stats](Stats& record) { record.merge(stats); }, stats);
+        }
+
+        void merge(const BasicRegistry& other) {
+            for (const Slot& slot : other.slots_) {
+                if (slot.stats.count != 0) {
+                    upsert(other.key_of(slot), slot.hash, [&slot](Stats& stats) { stats.merge(slot.stats); }, slot.stats);
+                }
+            }
+        }
+
+        [[nodiscard]] std::size_t capacity() const {
+            return slots_.size();
+        }
+
+        // Bytes taken by the keys, which live in one buffer next to each other.
+        [[nodiscard]] std::size_t key_bytes() const {
+            return keys_.size();
+        }
+
+        // Sizes the key buffer for `bytes` of keys up front, so filling a table of known cardinality allocates once.
+        void reserve_keys(std::size_t bytes) {
+            keys_.reserve(bytes);
+        }
+
+        // Entry `n` counts the keys a lookup finds after reading `n + 1` slots. It is derived from where the keys sit, so
+        // collecting it costs nothing while the table is being filled.
+        [[nodiscard]] std::vector<std::size_t> probe_histogram() const {
+            std::vector<std::size_t> histogram;
+            for (std::size_t index = 0; index != slots_.size(); ++index) {
+                if (slots_[index].stats.count == 0) {
+                    continue;
+                }
+
+                const auto distance = (index - slots_[index].hash) & mask_;
+                histogram.resize(std::max(histogram.size(), distance + 1));
+                histogram[distance]++;
+            }
+            return histogram;
+        }
+
+        // Number of keys whose full hash equals the hash of another key, which the stored hashes cannot tell apart.
+        [[nodiscard]] std::size_t hash_collisions() const {
+            std::vector<hash_type> hashes;
+            for (const Slot& slot : slots_) {
+                if (slot.stats.count != 0) {
+                    hashes.push_back(slot.hash);
+                }
+            }
+            std::sort(hashes.begin(), hashes.end());
+
+            std::size_t collisions = 0;
+            for (std::size_t i = 1; i < hashes.size(); ++i) {
+                collisions += (hashes[i] == hashes[i - 1]);
+            }
+            return collisions;
+        }
+
+    private:
+        struct Slot {
+            hash_type     hash       = 0;
+            std::uint32_t key_offset = 0;
+            std::uint32_t key_size   = 0;
+            Stats         stats;
+        };
+
+        [[nodiscard]] std::string_view key_of(const Slot& slot) const {
+            return {keys_.data() + slot.key_offset, slot.key_size};
+        }
+
+        // Index of the slot holding `station`, or of the empty slot where it belongs.
+        [[nodiscard]] std::size_t probe(std::string_view station, hash_type hash) const {
+            for (std::size_t index = hash & mask_;; index = (index + 1) & mask_) {
+                const Slot& slot = slots_[index];
+                if (slot.stats.count == 0 || (slot.hash == hash && key_of(slot) == station)) {
+                    return index;
+                }
+            }
+        }
+
+        template <typename Update>
+        void upsert(std::string_view station, hash_type hash, Update&& update, const Stats& initial) {
+            std::size_t index = probe(station, hash);
+            if (slots_[index].stats.count != 0) {
+                update(slots_[index].stats);
+                return;
+            }
+
+            // keep the load factor at or below one half, which keeps the probe sequences short
+            if (2 * (size_ + 1) > slots_.size()) {
+                grow();
+                index = probe(station, hash);
+            }
+
+            Slot& slot      = slots_[index];
+            slot.hash       = hash;
+            slot.key_offset = static_cast<std::uint32_t>(keys_.size());
+            slot.key_size   = static_cast<std::uint32_t>(station.size());
+            slot.stats      = initial;
+            keys_.insert(keys_.end(), station.begin(), station.end());
+            size_++;
+        }
+
+        void grow() {
+            std::vector<Slot> slots(2 * slots_.size());
+            mask_ = slots.size() - 1;
+            for (const Slot& slot : slots_) {
+                if (slot.stats.count == 0) {
+                    continue;
+                }
+
+                std::size_t index = slot.hash & mask_;
+                while (slots[index].stats.count != 0) {
+                    index = (index + 1) & mask_;
+                }
+                slots[index] = slot;
+            }
+            slots_ = std::move(slots);
+        }
+
+        Hasher hasher_;
+
+        std::vector<Slot> slots_;
+        std::size_t       mask_ = 0;
+        std::size_t       size_ = 0;
+        std::vector<char> keys_;
+    };
+
+    using Registry = BasicRegistry<StationHasher>;
+
+    template <typename T>
+    void write_value(std::ostream& output, const T& value) {
+        output.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    template <typename T>
+    [[nodiscard]] bool read_value(std::istream& input, T& value) {
+        return static_cast<bool>(input.read(reinterpret_cast<char*>(&value), sizeof(value)));
+    }
+
+    // Serializes a registry as a station count followed by (name length, name, min, max, sum, count) records.
+    inline void write_registry(std::ostream& output, const Registry& registry) {
+        write_value(output, static_cast<std::uint64_t>(registry.size()));
+        for (const auto& [station, stats] : registry) {
+            write_value(output, static_cast<std::uint32_t>(station.size()));
+            output.write(station.data(), static_cast<std::streamsize>(station.size()));
+            write_value(output, stats.min);
+            write_value(output, stats.max);
+            write_value(output, stats.sum);
+            write_value(output, static_cast<std::uint64_t>(stats.count));
+        }
+    }
+
+    // Has `write` fill a temporary file next to `path`, then renames it over `path`, so an interrupted run never leaves a
+    // torn file behind. False if opening, writing, closing or renaming fails; the temporary file is removed then.
+    template <typename Writer>
+    [[nodiscard]] bool write_atomically(const std::filesystem::path& path, Writer&& write) {
+        auto temporary_path = path;
+        temporary_path += ".tmp";
+
+        std::error_code error;
+        {
+            std::ofstream output(temporary_path, std::ios::binary | std::ios::trunc);
+            if (output) {
+                write(static_cast<std::ostream&>(output));
+                output.close();
+            }
+            if (output.fail()) {
+                std::filesystem::remove(temporary_path, error);
+                return false;
+            }
+        }
+
+        std::filesystem::rename(temporary_path, path, error);
+        if (error) {
+            std::filesystem::remove(temporary_path, error);
+            return false;
+        }
+        return true;
+    }
+
+    // Bytes between the read position of `input` and its end; nothing if the stream cannot seek.
+    [[nodiscard]] inline std::optional<std::uint64_t> remaining_bytes(std::istream& input) {
+        const auto position = input.tellg();
+        if (position == std::istream::pos_type(-1) || !input.seekg(0, std::ios::end)) {
+            input.clear();
+            return std::nullopt;
+        }
+        const auto end = input.tellg();
+        if (end == std::istream::pos_type(-1) || !input.seekg(position)) {
+            input.clear();
+            return std::nullopt;
+        }
+        return static_cast<std::uint64_t>(end - position);
+    }
+
+    // Empty if the stream is truncated or corrupt: the station count and the name lengths are checked against the bytes
+    // left before anything is allocated for them, and every record must hold at least one reading. The stream must be
+    // seekable, which files are.
+    [[nodiscard]] inline std::optional<Registry> read_registry(std::istream& input) {
+        constexpr std::uint64_t MIN_RECORD_SIZE =
+            sizeof(std::uint32_t) + sizeof(Stats::min) + sizeof(Stats::max) + sizeof(Stats::sum) + sizeof(std::uint64_t);
+
+        std::uint64_t size      = 0;
+        auto          remaining = remaining_bytes(input);
+        if (!remaining || !read_value(input, size) || size > (*remaining - sizeof(size)) / MIN_RECORD_SIZE) {
+            return std::nullopt;
+        }
+        *remaining -= sizeof(size);
+
+        Registry    registry(2 * size);
+        std::string station;
+        for (std::uint64_t i = 0; i != size; ++i) {
+            std::uint32_t length = 0;
+            if (*remaining < MIN_RECORD_SIZE || !read_value(input, length) || length > *remaining - MIN_RECORD_SIZE) {
+                return std::nullopt;
+            }
+            *remaining -= MIN_RECORD_SIZE + length;
+
+            station.resize(length);
+            Stats         stats;
+            std::uint64_t count = 0;
+            if (!input.read(station.data(), length) || !read_value(input, stats.min) || !read_value(input, stats.max)
+                || !read_value(input, stats.sum) || !read_value(input, count) || count == 0 || stats.min > stats.max) {
+                return std::nullopt;
+            }
+
+            stats.count = count;
+            registry.merge(station, stats);
+        }
+        return registry;
+    }
+}  // namespace brc
@@ -0,0 +1,299 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <numeric>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+namespace brc {
+    // Instrumentation behind `--stats`. Builds without BRC_STATS drop every call into it at compile time, so the default
+    // binary pays nothing for it.
+#if defined(BRC_STATS)
+    constexpr bool STATS_SUPPORTED = true;
+#else
+    constexpr bool STATS_SUPPORTED = false;
+#endif
+
+    // Reading the clock costs about as much as a row, so phases are timed on one row out of `STATS_SAMPLE_RATE`. The
+    // sampled times only give the split of a worker's busy time between the phases; a sampled row that took longer than
+    // `STATS_OUTLIER` was most likely descheduled and is left out.
+    constexpr std::size_t STATS_SAMPLE_RATE = 64;
+    constexpr auto        STATS_OUTLIER     = std::chrono::microseconds(50);
+
+    using StatsClock = std::chrono::steady_clock;
+
+    enum class Phase { scan, parse, lookup };
+
+    constexpr std::size_t PHASE_COUNT = 3;
+
+    // How well a worker's table, or the shared station dictionary, spreads its keys.
+    struct TableStats {
+        std::size_t              stations        = 0;
+        std::size_t              capacity        = 0;
+        std::size_t              hash_collisions = 0;
+        std::vector<std::size_t> probe_histogram;  // empty for tables that are indexed rather than probed
+
+        template <typename Table>
+        void record(const Table& table) {
+            stations = table.size();
+            capacity = table.capacity();
+            if constexpr (requires { table.probe_histogram(); }) {
+                hash_collisions = table.hash_collisions();
+                probe_histogram = table.probe_histogram();
+            }
+        }
+
+        [[nodiscard]] std::size_t displaced_keys() const {
+            return probe_histogram.empty() ? 0 : stations - probe_histogram.front();
+        }
+
+        [[nodiscard]] double mean_probe_length() const {
+            std::size_t reads = 0;
+            for (std::size_t distance = 0; distance != probe_histogram.size(); ++distance) {
+                reads += (distance + 1) * probe_histogram[distance];
+            }
+            return static_cast<double>(reads) / static_cast<double>(std::max<std::size_t>(stations, 1));
+        }
+    };
+
+    struct WorkerStats {
+        std::size_t segments = 0;
+        std::size_t bytes    = 0;
+        std::size_t rows     = 0;
+
+        std::array<std::chrono::nanoseconds, PHASE_COUNT> sampled{};  // per phase, sampled rows only
+
+        std::chrono::nanoseconds busy{};   // claiming and processing segments
+        std::chrono::nanoseconds merge{};  // handing the partial result over, including the merges done on the way
+        StatsClock::time_point   finished;
+
+        TableStats table;
+
+        // Share of the busy time spent in `phase`.
+        [[nodiscard]] std::chrono::nanoseconds phase_time(Phase phase) const {
+            const auto total = sampled[0] + sampled[1] + sampled[2];
+            if (total.count() == 0) {
+                return {};
+            }
+            const auto share = static_cast<double>(sampled[static_cast<std::size_t>(phase)].count()) / total.count();
+            return std::chrono::nanoseconds(static_cast<std::int64_t>(share * busy.count()));
+        }
+    };
+
+    // Splits the time spent on a row between its phases. Laps are only taken when the row is one of the sampled ones.
+    class PhaseTimer {
+    public:
+        explicit PhaseTimer(WorkerStats& stats)
+            : stats_(stats)
+            , sampled_(stats.rows % STATS_SAMPLE_RATE == 0) {
+            if (sampled_) {
+                last_ = StatsClock::now();
+            }
+        }
+
+        void lap(Phase phase) {
+            if (sampled_) {
+                const auto now                         = StatsClock::now();
+                laps_[static_cast<std::size_t>(phase)] = now - last_;
+                last_                                  = now;
+            }
+        }
+
+        // Adds the laps of a complete row to the worker and counts the row.
+        void commit() {
+            if (sampled_ && laps_[0] + laps_[1] + laps_[2] < STATS_OUTLIER) {
+                for (std::size_t i = 0; i != PHASE_COUNT; ++i) {
+                    stats_.sampled[i] += laps_[i];
+                }
+            }
+            stats_.rows++;
+        }
+
+    private:
+        WorkerStats&                                      stats_;
+        bool                                              sampled_;
+        StatsClock::time_point                            last_;
+        std::array<std::chrono::nanoseconds, PHASE_COUNT> laps_{};
+    };
+
+    struct RunStats {
+        std::vector<std::size_t>  segment_sizes;
+        std::vector<WorkerStats>  workers;
+        std::optional<TableStats> dictionary;  // when the workers share a station dictionary
+
+        std::chrono::nanoseconds split{};   // cutting the source into segments
+        std::chrono::nanoseconds gather{};  // from the last worker running out of segments to the merged result
+        std::chrono::nanoseconds print{};   // print_statistic
+        std::chrono::nanoseconds total{};
+    };
+
+    [[nodiscard]] inline double to_milliseconds(std::chrono::nanoseconds duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+
+    // Ratio of the largest value to the mean: 1.0 is a perfect balance.
+    template <typename Values, typename Projection>
+    [[nodiscard]] double imbalance(const Values& values, Projection&& projection) {
+        double total   = 0.0;
+        double largest = 0.0;
+        for (const auto& value : values) {
+            const auto amount = static_cast<double>(projection(value));
+            total += amount;
+            largest = std::max(largest, amount);
+        }
+        return (total == 0.0) ? 1.0 : largest * static_cast<double>(values.size()) / total;
+    }
+
+    [[nodiscard]] inline std::string join_histogram(const std::vector<std::size_t>& histogram) {
+        std::string result;
+        for (const auto count : histogram) {
+            result.append(result.empty() ? "" : ", ").append(std::to_string(count));
+        }
+        return result;
+    }
+
+    inline void write_table_row(std::ostream& output, const std::string& label, const TableStats& table) {
+        output << std::format(
+            "{:>6} {:>9} {:>9} {:>11.3f} {:>10} {:>16}  {}\n",
+            label,
+            table.stations,
+            table.capacity,
+            table.mean_probe_length(),
+            table.displaced_keys(),
+            table.hash_collisions,
+            join_histogram(table.probe_histogram)
+        );
+    }
+
+    [[nodiscard]] inline std::string table_json(const TableStats& table) {
+        return std::format(
+            "\"stations\": {}, \"capacity\": {}, \"mean_probe_length\": {:.3f}, \"displaced_keys\": {}, "
+            "\"hash_collisions\": {}, \"probe_histogram\": [{}]",
+            table.stations,
+            table.capacity,
+            table.mean_probe_length(),
+            table.displaced_keys(),
+            table.hash_collisions,
+            join_histogram(table.probe_histogram)
+        );
+    }
+
+    inline void write_stats_text(std::ostream& output, const RunStats& stats) {
+        const auto& segments = stats.segment_sizes;
+        if (!segments.empty()) {
+            const auto [smallest, largest] = std::minmax_element(segments.begin(), segments.end());
+            const auto total               = std::accumulate(segments.begin(), segments.end(), std::size_t{0});
+            output << std::format(
+                "Segments: {}, {} bytes on average, {} to {} bytes\n",
+                segments.size(),
+                total / segments.size(),
+                *smallest,
+                *largest
+            );
+        }
+
+        if (!stats.workers.empty()) {
+            output << std::format("Busy time is split between the phases on 1 row out of {}\n", STATS_SAMPLE_RATE);
+            output << "Worker  Segments          Bytes         Rows   Busy ms   Scan ms  Parse ms Lookup ms  Merge ms\n";
+            for (std::size_t i = 0; i != stats.workers.size(); ++i) {
+                const auto& worker = stats.workers[i];
+                output << std::format(
+                    "{:>6} {:>9} {:>14} {:>12} {:>9.1f} {:>9.1f} {:>9.1f} {:>9.1f} {:>9.1f}\n",
+                    i,
+                    worker.segments,
+                    worker.bytes,
+                    worker.rows,
+                    to_milliseconds(worker.busy),
+                    to_milliseconds(worker.phase_time(Phase::scan)),
+                    to_milliseconds(worker.phase_time(Phase::parse)),
+                    to_milliseconds(worker.phase_time(Phase::lookup)),
+                    to_milliseconds(worker.merge)
+                );
+            }
+
+            output << "Table   Stations  Capacity  Mean probe  Displaced  Hash collisions  Probe lengths\n";
+            for (std::size_t i = 0; i != stats.workers.size(); ++i) {
+                write_table_row(output, std::to_string(i), stats.workers[i].table);
+            }
+            if (stats.dictionary) {
+                write_table_row(output, "shared", *stats.dictionary);
+            }
+
+            output << std::format(
+                "Load imbalance (max / mean): busy {:.3f}, bytes {:.3f}, rows {:.3f}\n",
+                imbalance(stats.workers, [](const WorkerStats& worker) { return worker.busy.count(); }),
+                imbalance(stats.workers, [](const WorkerStats& worker) { return worker.bytes; }),
+                imbalance(stats.workers, [](const WorkerStats& worker) { return worker.rows; })
+            );
+        }
+
+        output << std::format(
+            "Split {:.1f} ms, gather {:.1f} ms, print {:.1f} ms, total {:.1f} ms\n",
+            to_milliseconds(stats.split),
+            to_milliseconds(stats.gather),
+            to_milliseconds(stats.print),
+            to_milliseconds(stats.total)
+        );
+    }
+
+    inline void write_stats_json(std::ostream& output, const RunStats& stats) {
+        const auto& segments = stats.segment_sizes;
+        const auto  total    = std::accumulate(segments.begin(), segments.end(), std::size_t{0});
+        const auto  smallest = segments.empty() ? 0 : *std::min_element(segments.begin(), segments.end());
+        const auto  largest  = segments.empty() ? 0 : *std::max_element(segments.begin(), segments.end());
+
+        output << "{\n";
+        output << std::format(
+            "    \"segments\": {{\"count\": {}, \"bytes\": {}, \"min_bytes\": {}, \"max_bytes\": {}}},\n",
+            segments.size(),
+            total,
+            smallest,
+            largest
+        );
+        output << std::format("    \"sample_rate\": {},\n", STATS_SAMPLE_RATE);
+        output << "    \"workers\": [\n";
+        for (std::size_t i = 0; i != stats.workers.size(); ++i) {
+            const auto& worker = stats.workers[i];
+            output << std::format(
+                "        {{\"segments\": {}, \"bytes\": {}, \"rows\": {}, \"busy_ms\": {:.3f}, \"scan_ms\": {:.3f}, "
+                "\"parse_ms\": {:.3f}, \"lookup_ms\": {:.3f}, \"merge_ms\": {:.3f}, {}}}{}\n",
+                worker.segments,
+                worker.bytes,
+                worker.rows,
+                to_milliseconds(worker.busy),
+                to_milliseconds(worker.phase_time(Phase::scan)),
+                to_milliseconds(worker.phase_time(Phase::parse)),
+                to_milliseconds(worker.phase_time(Phase::lookup)),
+                to_milliseconds(worker.merge),
+                table_json(worker.table),
+                (i + 1 != stats.workers.size()) ? "," : ""
+            );
+        }
+        output << "    ],\n";
+        if (stats.dictionary) {
+            output << std::format("    \"dictionary\": {{{}}},\n", table_json(*stats.dictionary));
+        }
+        output << std::format(
+            "    \"imbalance\": {{\"busy\": {:.3f}, \"bytes\": {:.3f}, \"rows\": {:.3f}}},\n",
+            imbalance(stats.workers, [](const WorkerStats& worker) { return worker.busy.count(); }),
+            imbalance(stats.workers, [](const WorkerStats& worker) { return worker.bytes; }),
+            imbalance(stats.workers, [](const WorkerStats& worker) { return worker.rows; })
+        );
+        output << std::format(
+            "    \"split_ms\": {:.3f},\n    \"gather_ms\": {:.3f},\n    \"print_ms\": {:.3f},\n    \"total_ms\": {:.3f}\n",
+            to_milliseconds(stats.split),
+            to_milliseconds(stats.gather),
+            to_milliseconds(stats.print),
+            to_milliseconds(stats.total)
+        );
+        output << "}\n";
+    }
+}  // namespace brc
@@ -0,0 +1,93 @@
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "scanning.hpp"
+
+
+// Checks the kernels of scanning.hpp, as compiled for the flags of this build, against portable references:
+// `find_byte` against `find_byte_swar` for every length, alignment and match position up to a few SIMD blocks, and
+// `decode_temperature` against a byte-by-byte parse for every temperature followed by every possible next byte. `ctest`
+// runs it once with the flags of the project and, where the build host runs them, once with AVX2 enabled.
+
+using namespace brc;
+
+[[nodiscard]] bool check_find_byte() {
+    constexpr std::size_t MAX_LENGTH = 160;
+    constexpr std::size_t ALIGNMENTS = 32;
+
+    std::mt19937                       generator(0x5eed);
+    std::uniform_int_distribution<int> byte(0, 255);
+
+    std::vector<char> buffer(ALIGNMENTS + MAX_LENGTH);
+    for (std::size_t length = 0; length <= MAX_LENGTH; ++length) {
+        for (std::size_t alignment = 0; alignment != ALIGNMENTS; ++alignment) {
+            // position `length` means no match at all; a second match further on must not be found instead
+            for (std::size_t position = 0; position <= length; ++position) {
+                const char* begin = buffer.data() + alignment;
+                const char* end   = begin + length;
+                for (auto& value : buffer) {
+                    value = static_cast<char>(byte(generator) | 1);  // odd bytes, so never the target
+                }
+                if (position != length) {
+                    buffer[alignment + position] = ';';
+                    if (position + 7 < length) {
+                        buffer[alignment + position + 7] = ';';
+                    }
+                }
+
+                const auto found    = find_byte(begin, end, ';');
+                const auto expected = find_byte_swar(begin, end, ';');
+                if (found != expected) {
+                    std::cerr << std::format(
+                        "find_byte: length {}, alignment {}, match at {}: found {} instead of {}\n", length, alignment,
+                        position, found - begin, expected - begin
+                    );
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+[[nodiscard]] bool check_decode_temperature() {
+    for (int tenths = -999; tenths <= 999; ++tenths) {
+        const auto magnitude = (tenths < 0) ? -tenths : tenths;
+        const auto field     = std::format("{}{}.{}", (tenths < 0) ? "-" : "", magnitude / 10, magnitude % 10);
+
+        // the reference: the field read one byte at a time
+        std::int64_t value = 0;
+        for (const char c : field) {
+            if (c >= '0' && c <= '9') {
+                value = 10 * value + (c - '0');
+            }
+        }
+        value = (field.front() == '-') ? -value : value;
+
+        for (int next = 0; next != 256; ++next) {
+            auto bytes = field + '\n';
+            bytes.push_back(static_cast<char>(next));
+
+            const auto decoded = decode_temperature(load_word(bytes.data(), bytes.data() + bytes.size()));
+            if (decoded.value != value || decoded.length != field.size()) {
+                std::cerr << std::format(
+                    "decode_temperature: \"{}\" followed by byte {} decoded as {} of length {}\n", field, next,
+                    decoded.value, decoded.length
+                );
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main() {
+    const auto find_byte_ok = check_find_byte();
+    const auto decode_ok    = check_decode_temperature();
+    return (find_byte_ok && decode_ok) ? 0 : 1;
+}
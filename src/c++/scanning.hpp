@@ -0,0 +1,111 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(__AVX2__) || defined(_M_X64)
+    #include <immintrin.h>
+#endif
+
+
+namespace brc {
+    static_assert(std::endian::native == std::endian::little, "the word-at-a-time kernels assume little-endian loads");
+
+    constexpr std::uint64_t SWAR_ONES = 0x0101010101010101ULL;
+    constexpr std::uint64_t SWAR_HIGH = 0x8080808080808080ULL;
+
+    // Loads up to 8 bytes starting at `bytes`; anything past `end` reads as zero. Usable in constant expressions, where
+    // the bytes are assembled one by one.
+    [[nodiscard]] constexpr std::uint64_t load_word(const char* bytes, const char* end) {
+        std::uint64_t word = 0;
+        if (std::is_constant_evaluated()) {
+            for (std::size_t i = 0; i != sizeof(word) && bytes + i < end; ++i) {
+                word |= static_cast<std::uint64_t>(static_cast<unsigned char>(bytes[i])) << (8 * i);
+            }
+        } else if (end - bytes >= static_cast<std::ptrdiff_t>(sizeof(word))) {
+            std::memcpy(&word, bytes, sizeof(word));
+        } else if (end > bytes) {
+            std::memcpy(&word, bytes, static_cast<std::size_t>(end - bytes));
+        }
+        return word;
+    }
+
+    // Sets the high bit of every byte of `word` that equals the byte in `pattern` (bits above the first match may be
+    // false positives, so only the lowest set bit is meaningful).
+    [[nodiscard]] inline std::uint64_t match_bytes(std::uint64_t word, std::uint64_t pattern) {
+        const std::uint64_t diff = word ^ pattern;
+        return (diff - SWAR_ONES) & ~diff & SWAR_HIGH;
+    }
+
+    // The portable part of `find_byte`, 8 bytes per step and then byte by byte; what the SIMD loops are checked against.
+    [[nodiscard]] inline const char* find_byte_swar(const char* begin, const char* end, char target) {
+        const std::uint64_t pattern = SWAR_ONES * static_cast<unsigned char>(target);
+        for (; end - begin >= 8; begin += 8) {
+            if (const auto mask = match_bytes(load_word(begin, end), pattern); mask != 0) {
+                return begin + std::countr_zero(mask) / 8;
+            }
+        }
+
+        for (; begin != end; ++begin) {
+            if (*begin == target) {
+                return begin;
+            }
+        }
+        return end;
+    }
+
+    // Returns a pointer to the first `target` in [begin, end), or `end` if there is none.
+    [[nodiscard]] inline const char* find_byte(const char* begin, const char* end, char target) {
+#if defined(__AVX2__)
+        const __m256i wide_pattern = _mm256_set1_epi8(target);
+        for (; end - begin >= 32; begin += 32) {
+            const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+            const auto    mask  = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, wide_pattern)));
+            if (mask != 0) {
+                return begin + std::countr_zero(mask);
+            }
+        }
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64)
+        const __m128i narrow_pattern = _mm_set1_epi8(target);
+        for (; end - begin >= 16; begin += 16) {
+            const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+            const auto    mask  = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, narrow_pattern)));
+            if (mask != 0) {
+                return begin + std::countr_zero(mask);
+            }
+        }
+#endif
+
+        return find_byte_swar(begin, end, target);
+    }
+
+    struct DecodedTemperature {
+        std::int64_t value;   // fixed-point, tenths of a degree
+        std::size_t  length;  // size of the field in bytes, the line break excluded
+    };
+
+    // Decodes a "-?d?d.d" field from the little-endian `word` that starts with it, without any branches.
+    // Only the '.' has bit 4 clear among the bytes 1..3, which locates the decimal point; the digits are then shifted into
+    // fixed lanes and combined with a single multiplication (100 * a + 10 * b + c lands in bits 32..41).
+    [[nodiscard]] inline DecodedTemperature decode_temperature(std::uint64_t word) {
+        const std::uint64_t negated   = ~word;
+        const int           dot_bit   = std::countr_zero(negated & 0x10101000ULL);
+        const std::int64_t  sign      = static_cast<std::int64_t>(negated << 59) >> 63;  // -1 for '-', 0 otherwise
+        const std::uint64_t sign_mask = ~(static_cast<std::uint64_t>(sign) & 0xFF);
+        const std::uint64_t digits    = ((word & sign_mask) << (28 - dot_bit)) & 0x0F000F0F00ULL;
+        const auto          absolute  = static_cast<std::int64_t>(((digits * 0x640A0001ULL) >> 32) & 0x3FF);
+
+        return {(absolute ^ sign) - sign, static_cast<std::size_t>(dot_bit / 8 + 2)};
+    }
+
+    [[nodiscard]] inline std::int64_t parse_temperature(std::string_view bytes) {
+        return decode_temperature(load_word(bytes.data(), bytes.data() + bytes.size())).value;
+    }
+}  // namespace brc
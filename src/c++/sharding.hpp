@@ -0,0 +1,177 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "aggregation.hpp"
+#include "binary-measurements.hpp"
+#include "mapped-file.hpp"
+#include "registry.hpp"
+
+
+namespace brc {
+    constexpr char          PARTIAL_MAGIC[4] = {'B', 'R', 'C', 'P'};
+    constexpr std::uint32_t PARTIAL_VERSION  = 2;
+
+    // The `index`-th of `count` shards of a job, as given by `--shard index/count`.
+    struct Shard {
+        std::size_t index = 0;
+        std::size_t count = 1;
+    };
+
+    [[nodiscard]] inline std::optional<Shard> parse_shard(std::string_view text) {
+        const auto slash = text.find('/');
+        if (slash == std::string_view::npos) {
+            return std::nullopt;
+        }
+
+        Shard      shard;
+        const auto index = std::from_chars(text.data(), text.data() + slash, shard.index);
+        const auto count = std::from_chars(text.data() + slash + 1, text.data() + text.size(), shard.count);
+        if (index.ec != std::errc{} || index.ptr != text.data() + slash || count.ec != std::errc{}
+            || count.ptr != text.data() + text.size() || shard.count == 0 || shard.index >= shard.count) {
+            return std::nullopt;
+        }
+        return shard;
+    }
+
+    // The records of `source` that belong to `shard`: those starting in its share of the bytes. Every shard finds its
+    // bounds on its own, and together the shards cover each record exactly once.
+    [[nodiscard]] inline std::string_view shard_view(std::string_view source, const Shard& shard) {
+        const auto record_start = [source](std::size_t position) {
+            if (position == 0 || position >= source.size()) {
+                return std::min(position, source.size());
+            }
+            const auto line_break = source.find('\n', position - 1);
+            return (line_break == std::string_view::npos) ? source.size() : line_break + 1;
+        };
+
+        const auto first = record_start(source.size() / shard.count * shard.index);
+        const auto last  = (shard.index + 1 == shard.count) ? source.size()
+                                                            : record_start(source.size() / shard.count * (shard.index + 1));
+        return source.substr(first, std::max(first, last) - first);
+    }
+
+    // The regular files of `directory` that belong to `shard`, dealt out in name order.
+    [[nodiscard]] inline std::vector<std::filesystem::path> shard_files(
+        const std::filesystem::path& directory, const Shard& shard
+    ) {
+        std::vector<std::filesystem::path> files;
+        for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+            if (entry.is_regular_file()) {
+                files.push_back(entry.path());
+            }
+        }
+        std::sort(files.begin(), files.end());
+
+        std::vector<std::filesystem::path> selected;
+        for (std::size_t i = shard.index; i < files.size(); i += shard.count) {
+            selected.push_back(std::move(files[i]));
+        }
+        return selected;
+    }
+
+#if defined(BRC_HAS_MMAP)
+    // Aggregates the files of `shard` one after the other, each over all the workers, text and binary alike. Empty if a
+    // binary file is malformed.
+    [[nodiscard]] inline std::optional<Registry> process_directory(
+        const std::filesystem::path& directory,
+        const Shard&                 shard,
+        std::size_t                  cpu_count,
+        std::size_t                  segment_size,
+        const MapOptions&            map_options
+    ) {
+        Registry registry;
+        for (const auto& path : shard_files(directory, shard)) {
+            const MappedFile source(path, map_options);
+            if (const auto layout = read_binary_layout(source.view())) {
+                auto result = process_binary(*layout, cpu_count);
+                if (!result) {
+                    return std::nullopt;
+                }
+                registry.merge(*result);
+            } else if (is_binary_measurements(source.view())) {
+                return std::nullopt;
+            } else {
+                registry.merge(process_measurements(source.view(), cpu_count, segment_size));
+            }
+        }
+        return registry;
+    }
+#endif
+
+    // Size of the whole source of a job, the files of a directory together; 0 if it cannot be known, e.g. for a pipe.
+    [[nodiscard]] inline std::uint64_t source_size(const std::filesystem::path& path) {
+        std::error_code error;
+        if (!std::filesystem::is_directory(path, error)) {
+            const auto size = std::filesystem::file_size(path, error);
+            return error ? 0 : size;
+        }
+
+        std::uint64_t total = 0;
+        for (const auto& entry : std::filesystem::directory_iterator(path)) {
+            if (entry.is_regular_file()) {
+                total += entry.file_size();
+            }
+        }
+        return total;
+    }
+
+    // What a partial result covers: its shard of the job and the size of the job's whole source, so that `merge` can
+    // tell whether a set of partials makes up one job. A result of the whole source, merged or not, is shard 0/1.
+    struct PartialHeader {
+        Shard         shard;
+        std::uint64_t source_size = 0;
+    };
+
+    struct Partial {
+        PartialHeader header;
+        Registry      registry;
+    };
+
+    // A partial result of a sharded job, serialized like the snapshots: a header and the registry, written atomically.
+    [[nodiscard]] inline bool save_partial(
+        const std::filesystem::path& path, const PartialHeader& header, const Registry& registry
+    ) {
+        return write_atomically(path, [&](std::ostream& output) {
+            output.write(PARTIAL_MAGIC, sizeof(PARTIAL_MAGIC));
+            write_value(output, PARTIAL_VERSION);
+            write_value(output, static_cast<std::uint64_t>(header.shard.index));
+            write_value(output, static_cast<std::uint64_t>(header.shard.count));
+            write_value(output, header.source_size);
+            write_registry(output, registry);
+        });
+    }
+
+    [[nodiscard]] inline std::optional<Partial> load_partial(const std::filesystem::path& path) {
+        std::ifstream input(path, std::ios::binary);
+        if (!input) {
+            return std::nullopt;
+        }
+
+        char          magic[sizeof(PARTIAL_MAGIC)] = {};
+        std::uint32_t version                      = 0;
+        std::uint64_t index                        = 0;
+        std::uint64_t count                        = 0;
+        std::uint64_t size                         = 0;
+        if (!read_value(input, magic) || std::memcmp(magic, PARTIAL_MAGIC, sizeof(magic)) != 0 || !read_value(input, version)
+            || version != PARTIAL_VERSION || !read_value(input, index) || !read_value(input, count)
+            || !read_value(input, size) || count == 0 || index >= count) {
+            return std::nullopt;
+        }
+
+        auto registry = read_registry(input);
+        if (!registry) {
+            return std::nullopt;
+        }
+        return Partial{{{static_cast<std::size_t>(index), static_cast<std::size_t>(count)}, size}, std::move(*registry)};
+    }
+}  // namespace brc
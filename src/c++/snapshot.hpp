@@ -0,0 +1,119 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "aggregation.hpp"
+#include "registry.hpp"
+#include "split-index.hpp"
+
+
+namespace brc {
+    constexpr char          SNAPSHOT_MAGIC[4]    = {'B', 'R', 'C', 'S'};
+    constexpr std::uint32_t SNAPSHOT_VERSION    = 2;
+    constexpr std::size_t   SNAPSHOT_BLOCK_SIZE = 16 * 1024 * 1024;
+
+    // State of an incremental run: the merged registry of the first `offset` bytes of the source.
+    struct Snapshot {
+        std::uint64_t offset   = 0;  // always just past a line break
+        std::uint64_t checksum = 0;
+        Registry      registry;
+    };
+
+    // Fingerprint of the first `offset` bytes of the source: every byte of them is hashed, so an edit anywhere in the
+    // prefix is noticed, also one that keeps the size of the file. The prefix is hashed in blocks on `cpu_count`
+    // threads, with the `block_checksum` of the split index, which reads far faster than the records are aggregated.
+    [[nodiscard]] inline std::uint64_t prefix_checksum(std::string_view source, std::size_t offset, std::size_t cpu_count) {
+        const auto prefix      = source.substr(0, offset);
+        const auto block_count = (prefix.size() + SNAPSHOT_BLOCK_SIZE - 1) / SNAPSHOT_BLOCK_SIZE;
+
+        std::vector<std::uint64_t> checksums(block_count);
+        std::atomic<std::size_t>   next_block = 0;
+
+        const auto worker = [&](Registry&, WorkerStats*) {
+            for (auto i = next_block++; i < block_count; i = next_block++) {
+                checksums[i] = block_checksum(prefix.substr(i * SNAPSHOT_BLOCK_SIZE, SNAPSHOT_BLOCK_SIZE));
+            }
+        };
+        static_cast<void>(run_workers(std::min(cpu_count, std::max<std::size_t>(block_count, 1)), worker));
+
+        std::uint64_t checksum = offset * WordHasher::MULTIPLIER;
+        for (const auto block : checksums) {
+            checksum = (std::rotl(checksum, 21) ^ block) * WordHasher::MULTIPLIER;
+        }
+        return checksum;
+    }
+
+    [[nodiscard]] inline std::optional<Snapshot> load_snapshot(const std::filesystem::path& path) {
+        std::ifstream input(path, std::ios::binary);
+        if (!input) {
+            return std::nullopt;
+        }
+
+        char          magic[sizeof(SNAPSHOT_MAGIC)] = {};
+        std::uint32_t version                       = 0;
+        Snapshot      snapshot;
+        if (!read_value(input, magic) || std::memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) != 0
+            || !read_value(input, version) || version != SNAPSHOT_VERSION || !read_value(input, snapshot.offset)
+            || !read_value(input, snapshot.checksum)) {
+            return std::nullopt;
+        }
+
+        auto registry = read_registry(input);
+        if (!registry) {
+            return std::nullopt;
+        }
+        snapshot.registry = std::move(*registry);
+        return snapshot;
+    }
+
+    [[nodiscard]] inline bool save_snapshot(const std::filesystem::path& path, const Snapshot& snapshot) {
+        return write_atomically(path, [&](std::ostream& output) {
+            output.write(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+            write_value(output, SNAPSHOT_VERSION);
+            write_value(output, snapshot.offset);
+            write_value(output, snapshot.checksum);
+            write_registry(output, snapshot.registry);
+        });
+    }
+
+    // Aggregates only what was appended to the source since the snapshot was taken and merges it into the snapshot's
+    // registry; falls back to the whole file when the snapshot is missing or the prefix no longer matches. A trailing
+    // line without its line break is left for the next run.
+    [[nodiscard]] inline Registry process_incremental(
+        std::string_view source, const std::filesystem::path& snapshot_path, std::size_t cpu_count, std::size_t segment_size
+    ) {
+        auto loaded = load_snapshot(snapshot_path);
+        if (loaded
+            && (loaded->offset > source.size() || prefix_checksum(source, loaded->offset, cpu_count) != loaded->checksum)) {
+            std::cerr << "The snapshot does not match the source, aggregating the whole file\n";
+            loaded.reset();
+        }
+        Snapshot snapshot = loaded ? std::move(*loaded) : Snapshot();
+
+        const auto last_line_break = source.rfind('\n');
+        const auto complete_size   = (last_line_break == std::string_view::npos) ? 0 : last_line_break + 1;
+        if (complete_size > snapshot.offset) {
+            const auto appended = source.substr(snapshot.offset, complete_size - snapshot.offset);
+            snapshot.registry.merge(process_measurements(appended, cpu_count, segment_size));
+            snapshot.offset = complete_size;
+        }
+        snapshot.checksum = prefix_checksum(source, snapshot.offset, cpu_count);
+
+        if (!save_snapshot(snapshot_path, snapshot)) {
+            std::cerr << std::format("Failed to save the snapshot to {}\n", snapshot_path.string());
+        }
+        return std::move(snapshot.registry);
+    }
+}  // namespace brc
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "aggregation.hpp"
+#include "registry.hpp"
+
+
+namespace brc {
+    constexpr char          INDEX_MAGIC[4]      = {'B', 'R', 'C', 'X'};
+    constexpr std::uint32_t INDEX_VERSION       = 2;
+    constexpr std::size_t   INDEX_BLOCK_SIZE_MB = 64;
+
+    // A newline-aligned block of the source with the records it held when the index was built.
+    struct IndexBlock {
+        std::uint64_t offset   = 0;
+        std::uint64_t size     = 0;
+        std::uint64_t checksum = 0;
+        Registry      summary;
+    };
+
+    // Sidecar of a text source: the source cut into blocks that cover it from the start, each with its summary.
+    struct SplitIndex {
+        std::vector<IndexBlock> blocks;
+
+        // Where the indexed part of the source ends.
+        [[nodiscard]] std::uint64_t size() const {
+            return blocks.empty() ? 0 : blocks.back().offset + blocks.back().size;
+        }
+    };
+
+    // Fingerprint of a block: a hash of all of its bytes and its size, so an edit anywhere in the block is noticed, even
+    // one that keeps the size and the modification time. Hashing reads the block once, word by word, which is still far
+    // cheaper than aggregating it again.
+    [[nodiscard]] inline std::uint64_t block_checksum(std::string_view block) {
+        return WordHasher{}(block) ^ (block.size() * WordHasher::MULTIPLIER);
+    }
+
+    // Aggregates `source` block by block on `cpu_count` threads, keeping the summary of every block, and returns the total
+    // next to the index. The records of a block are the ones a run would aggregate for it, so a trailing line without its
+    // line break belongs to the last block.
+    [[nodiscard]] inline std::pair<Registry, SplitIndex> build_split_index(
+        std::string_view source, std::size_t cpu_count, std::size_t block_size
+    ) {
+        const auto segments = split_segments(source, block_size);
+
+        SplitIndex index;
+        index.blocks.resize(segments.size());
+
+        std::atomic<std::size_t> next_block = 0;
+
+        const auto worker = [&](Registry& total, WorkerStats*) {
+            for (auto i = next_block++; i < segments.size(); i = next_block++) {
+                const auto block = source.substr(segments[i].offset, segments[i].size);
+
+                IndexBlock& entry = index.blocks[i];
+                entry.offset      = segments[i].offset;
+                entry.size        = segments[i].size;
+                entry.checksum    = block_checksum(block);
+                process_chunk(block, entry.summary);
+                total.merge(entry.summary);
+            }
+        };
+        auto total = run_workers(std::max<std::size_t>(cpu_count, 1), worker);
+        return {std::move(total), std::move(index)};
+    }
+
+    // Aggregates `source` from its index: a block whose fingerprint still matches is answered from its summary, any other
+    // block is aggregated again between the same offsets, and what was appended after the indexed part is aggregated as
+    // usual. The blocks are checked on `cpu_count` threads, and the stale ones are aggregated together with the appended
+    // part, in a single pass over their segments. Empty if the blocks no longer start and end on line breaks, i.e. the
+    // source was rewritten rather than edited in place or appended to.
+    [[nodiscard]] inline std::optional<Registry> process_indexed(
+        std::string_view source, const SplitIndex& index, std::size_t cpu_count, std::size_t segment_size
+    ) {
+        const auto starts_line = [&](std::uint64_t offset) {
+            return offset == 0 || (offset <= source.size() && source[offset - 1] == '\n');
+        };
+
+        for (const auto& block : index.blocks) {
+            const auto end = block.offset + block.size;
+            if (!starts_line(block.offset) || end > source.size() || !(starts_line(end) || end == source.size())) {
+                return std::nullopt;
+            }
+        }
+
+        std::vector<char>        stale(index.blocks.size(), false);  // not vector<bool>, the workers set it concurrently
+        std::atomic<std::size_t> next_block = 0;
+
+        const auto worker = [&](Registry& registry, WorkerStats*) {
+            for (auto i = next_block++; i < index.blocks.size(); i = next_block++) {
+                const auto& block = index.blocks[i];
+                if (block_checksum(source.substr(block.offset, block.size)) == block.checksum) {
+                    registry.merge(block.summary);
+                } else {
+                    stale[i] = true;
+                }
+            }
+        };
+        auto registry = run_workers(std::max<std::size_t>(cpu_count, 1), worker);
+
+        std::vector<Segment> segments;
+        const auto           add_range = [&](std::size_t offset, std::size_t size) {
+            for (auto segment : split_segments(source.substr(offset, size), segment_size)) {
+                segment.offset += offset;
+                segments.push_back(segment);
+            }
+        };
+        for (std::size_t i = 0; i != index.blocks.size(); ++i) {
+            if (stale[i]) {
+                add_range(index.blocks[i].offset, index.blocks[i].size);
+            }
+        }
+        if (index.size() < source.size()) {
+            add_range(index.size(), source.size() - index.size());
+        }
+
+        if (!segments.empty()) {
+            registry.merge(process_segments(source, segments, cpu_count));
+        }
+        return registry;
+    }
+
+    [[nodiscard]] inline std::optional<SplitIndex> load_split_index(const std::filesystem::path& path) {
+        std::ifstream input(path, std::ios::binary);
+        if (!input) {
+            return std::nullopt;
+        }
+
+        char          magic[sizeof(INDEX_MAGIC)] = {};
+        std::uint32_t version                    = 0;
+        std::uint64_t block_count                = 0;
+        if (!read_value(input, magic) || std::memcmp(magic, INDEX_MAGIC, sizeof(magic)) != 0 || !read_value(input, version)
+            || version != INDEX_VERSION || !read_value(input, block_count)) {
+            return std::nullopt;
+        }
+
+        SplitIndex index;
+        for (std::uint64_t i = 0; i != block_count; ++i) {
+            IndexBlock block;
+            if (!read_value(input, block.offset) || !read_value(input, block.size) || !read_value(input, block.checksum)) {
+                return std::nullopt;
+            }
+
+            auto summary = read_registry(input);
+            if (!summary || block.offset != index.size()) {
+                return std::nullopt;  // the blocks must cover the source from its start
+            }
+            block.summary = std::move(*summary);
+            index.blocks.push_back(std::move(block));
+        }
+        return index;
+    }
+
+    [[nodiscard]] inline bool save_split_index(const std::filesystem::path& path, const SplitIndex& index) {
+        return write_atomically(path, [&](std::ostream& output) {
+            output.write(INDEX_MAGIC, sizeof(INDEX_MAGIC));
+            write_value(output, INDEX_VERSION);
+            write_value(output, static_cast<std::uint64_t>(index.blocks.size()));
+            for (const auto& block : index.blocks) {
+                write_value(output, block.offset);
+                write_value(output, block.size);
+                write_value(output, block.checksum);
+                write_registry(output, block.summary);
+            }
+        });
+    }
+}  // namespace brc
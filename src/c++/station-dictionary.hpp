@@ -0,0 +1,270 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "known-stations.hpp"
+#include "registry.hpp"
+
+
+namespace brc {
+    // Starts loading the cache line of `address` without waiting for it; a hint that compiles to nothing where it is
+    // not available.
+    inline void prefetch_line(const void* address) {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_prefetch(address);
+#elif defined(_M_X64)
+        _mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#else
+        static_cast<void>(address);
+#endif
+    }
+
+    // Station names shared by all workers, each numbered the first time any worker sees it.
+    //
+    // An open-addressing table of fixed capacity where a slot is claimed with a single compare-and-swap; lookups and
+    // inserts never take a lock, and an inserter only waits for a slot that another thread is filling at that very moment.
+    // Names are copied into one preallocated arena, next to each other rather than scattered over the source, which keeps
+    // the key compares of a lookup in cache. The arena has room for the longest names but is left uninitialized, so only
+    // the pages names are written to are ever backed by memory. The known stations are numbered first, in list order, so
+    // their ids are the indices of KNOWN_STATION_HASH.
+    class StationDictionary {
+    public:
+        using hash_type = Registry::hash_type;
+
+        static constexpr std::uint32_t NONE                 = UINT32_MAX;
+        static constexpr std::size_t   DEFAULT_MAX_STATIONS = 32 * 1024;
+        static constexpr std::size_t   MAX_NAME_SIZE        = 100;  // the arena has room for `max_stations` names this long
+
+        explicit StationDictionary(std::size_t max_stations = DEFAULT_MAX_STATIONS)
+            : max_stations_(max_stations)
+            , slots_(std::make_unique<Slot[]>(std::bit_ceil(2 * std::max<std::size_t>(max_stations, 1))))
+            , arena_(std::make_unique_for_overwrite<char[]>(max_stations * MAX_NAME_SIZE))
+            , names_(std::bit_ceil(2 * std::max<std::size_t>(max_stations, 1)))
+            , mask_(names_.size() - 1) {
+            if constexpr (KNOWN_STATIONS_ENABLED) {
+                for (const auto& station : KNOWN_STATIONS) {
+                    static_cast<void>(find_or_insert(station.name, Registry::hasher_type{}(station.name)));
+                }
+            }
+        }
+
+        // Id of `station`, numbering it if it is new, or NONE once `max_stations` names have been numbered or the arena is
+        // full. `hash` must be what `Registry::hasher_type` yields for `station`.
+        [[nodiscard]] std::uint32_t find_or_insert(std::string_view station, hash_type hash) {
+            for (std::size_t index = hash & mask_;; index = (index + 1) & mask_) {
+                Slot&         slot  = slots_[index];
+                std::uint32_t state = slot.state.load(std::memory_order_acquire);
+
+                if (state == EMPTY) {
+                    if (size() >= max_stations_) {
+                        return NONE;
+                    }
+
+                    // the bytes are claimed before the slot, so a slot is never left half filled; losing the race for
+                    // the slot wastes them
+                    const auto offset = arena_used_.fetch_add(station.size(), std::memory_order_relaxed);
+                    if (offset + station.size() > max_stations_ * MAX_NAME_SIZE) {
+                        return NONE;
+                    }
+                    if (slot.state.compare_exchange_strong(state, BUSY, std::memory_order_acquire)) {
+                        const auto id = next_id_.fetch_add(1, std::memory_order_relaxed);
+                        std::copy(station.begin(), station.end(), &arena_[offset]);
+
+                        slot.size  = static_cast<std::uint32_t>(station.size());
+                        slot.hash  = hash;
+                        slot.data  = &arena_[offset];
+                        names_[id] = slot.name();
+                        slot.state.store(id + FIRST_ID, std::memory_order_release);
+                        return id;
+                    }
+                }
+
+                while (state == BUSY) {
+                    std::this_thread::yield();
+                    state = slot.state.load(std::memory_order_acquire);
+                }
+                if (slot.hash == hash && slot.name() == station) {
+                    return state - FIRST_ID;
+                }
+            }
+        }
+
+        // Like `find_or_insert`, but known stations are looked up in KNOWN_STATION_HASH first, which takes a single compare.
+        [[nodiscard]] std::uint32_t id(std::string_view station, hash_type hash) {
+            if (const auto known = known_id(station, hash); known != NONE) {
+                return known;
+            }
+            return find_or_insert(station, hash);
+        }
+
+        // Id of `station` if it is a known station, NONE otherwise. Only KNOWN_STATION_HASH is read, never the slots.
+        [[nodiscard]] static std::uint32_t known_id(std::string_view station, hash_type hash) {
+            if constexpr (KNOWN_STATIONS_ENABLED) {
+                if (const auto index = KNOWN_STATION_HASH.find(station, hash); index != KNOWN_STATION_HASH.NONE) {
+                    return static_cast<std::uint32_t>(index);
+                }
+            }
+            return NONE;
+        }
+
+        // Number of ids handed out; all of them are below it.
+        [[nodiscard]] std::size_t size() const {
+            return std::min<std::size_t>(next_id_.load(std::memory_order_acquire), names_.size());
+        }
+
+        // Starts loading the slot `find_or_insert` probes first for `hash`, for callers that know their next names in
+        // advance. Known stations do not need it, `id` finds them without reading the slots.
+        void prefetch(hash_type hash) const {
+            prefetch_line(&slots_[hash & mask_]);
+        }
+
+        // Only meaningful once the workers are done with the dictionary.
+        [[nodiscard]] std::string_view name(std::uint32_t id) const {
+            return names_[id];
+        }
+
+        [[nodiscard]] std::size_t capacity() const {
+            return names_.size();
+        }
+
+        // Bytes of names stored, an upper bound on what the names of all ids take.
+        [[nodiscard]] std::size_t name_bytes() const {
+            return std::min(arena_used_.load(std::memory_order_acquire), max_stations_ * MAX_NAME_SIZE);
+        }
+
+        // The same measures as `BasicRegistry` offers, for `--stats`.
+        [[nodiscard]] std::vector<std::size_t> probe_histogram() const {
+            std::vector<std::size_t> histogram;
+            for (std::size_t index = 0; index != capacity(); ++index) {
+                if (slots_[index].state.load(std::memory_order_acquire) < FIRST_ID) {
+                    continue;
+                }
+
+                const auto distance = (index - slots_[index].hash) & mask_;
+                histogram.resize(std::max(histogram.size(), distance + 1));
+                histogram[distance]++;
+            }
+            return histogram;
+        }
+
+        [[nodiscard]] std::size_t hash_collisions() const {
+            std::vector<hash_type> hashes;
+            for (std::size_t index = 0; index != capacity(); ++index) {
+                if (slots_[index].state.load(std::memory_order_acquire) >= FIRST_ID) {
+                    hashes.push_back(slots_[index].hash);
+                }
+            }
+            std::sort(hashes.begin(), hashes.end());
+
+            std::size_t collisions = 0;
+            for (std::size_t i = 1; i < hashes.size(); ++i) {
+                collisions += (hashes[i] == hashes[i - 1]);
+            }
+            return collisions;
+        }
+
+    private:
+        static constexpr std::uint32_t EMPTY    = 0;
+        static constexpr std::uint32_t BUSY     = 1;
+        static constexpr std::uint32_t FIRST_ID = 2;  // a published slot holds its id + FIRST_ID
+
+        struct Slot {
+            std::atomic<std::uint32_t> state = EMPTY;
+            std::uint32_t              size  = 0;
+            hash_type                  hash  = 0;
+            const char*                data  = nullptr;
+
+            [[nodiscard]] std::string_view name() const {
+                return {data, size};
+            }
+        };
+
+        std::size_t                   max_stations_;
+        std::unique_ptr<Slot[]>       slots_;
+        std::unique_ptr<char[]>       arena_;
+        std::vector<std::string_view> names_;
+        std::size_t                   mask_;
+        std::atomic<std::uint32_t>    next_id_    = 0;
+        std::atomic<std::size_t>      arena_used_ = 0;
+    };
+
+    // One worker's records, indexed by dictionary id, so merging two of them is an element-wise addition with no hashing
+    // or key compares. Names the full dictionary refuses go to a private registry instead.
+    class DenseTable {
+    public:
+        explicit DenseTable(StationDictionary& dictionary)
+            : dictionary_(&dictionary)
+            , stats_(dictionary.size()) {}
+
+        void add(std::string_view station, Registry::hash_type hash, std::int64_t temperature) {
+            const auto id = dictionary_->id(station, hash);
+            if (id == StationDictionary::NONE) {
+                overflow_.add(station, hash, temperature);
+            } else {
+                add(id, temperature);
+            }
+        }
+
+        // Starts loading the record of `id`, for callers that know their next ids in advance.
+        void prefetch(std::uint32_t id) const {
+            if (id < stats_.size()) {
+                prefetch_line(&stats_[id]);
+            }
+        }
+
+        // `id` must come from the table's dictionary.
+        void add(std::uint32_t id, std::int64_t temperature) {
+            if (id >= stats_.size()) {
+                stats_.resize(std::max<std::size_t>(id + 1, 2 * stats_.size()));
+            }
+            stats_[id].add(temperature);
+        }
+
+        void merge(const DenseTable& other) {
+            stats_.resize(std::max(stats_.size(), other.stats_.size()));
+            for (std::size_t id = 0; id != other.stats_.size(); ++id) {
+                stats_[id].merge(other.stats_[id]);
+            }
+            if (!other.overflow_.empty()) {
+                overflow_.merge(other.overflow_);
+            }
+        }
+
+        // Number of stations with records.
+        [[nodiscard]] std::size_t size() const {
+            const auto used =
+                std::count_if(stats_.begin(), stats_.end(), [](const Stats& stats) { return stats.count != 0; });
+            return overflow_.size() + static_cast<std::size_t>(used);
+        }
+
+        // Number of ids with room for a record, which is what merging this table into another walks.
+        [[nodiscard]] std::size_t capacity() const {
+            return stats_.size();
+        }
+
+        [[nodiscard]] Registry to_registry() const {
+            Registry registry(2 * (dictionary_->size() + overflow_.size()));
+            registry.reserve_keys(dictionary_->name_bytes() + overflow_.key_bytes());
+            for (std::size_t id = 0; id != stats_.size(); ++id) {
+                if (stats_[id].count != 0) {
+                    registry.merge(dictionary_->name(static_cast<std::uint32_t>(id)), stats_[id]);
+                }
+            }
+            registry.merge(overflow_);
+            return registry;
+        }
+
+    private:
+        StationDictionary* dictionary_;
+        std::vector<Stats> stats_;
+        Registry           overflow_;
+    };
+}  // namespace brc
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "aggregation.hpp"
+#include "registry.hpp"
+#include "run-stats.hpp"
+#include "station-dictionary.hpp"
+
+
+namespace brc {
+    // A fixed set of buffers cycling between the readers and the parsers: a reader fills free blocks and publishes them,
+    // a parser takes a filled block, aggregates it and gives it back. Nothing else is allocated for the data, so a source
+    // of any length is read in `block_count * block_size` bytes. Blocks are aligned to `alignment` when `block_size` is a
+    // multiple of it.
+    class BlockPool {
+    public:
+        struct Block {
+            char*       data  = nullptr;
+            std::size_t size  = 0;
+            std::size_t index = 0;  // where the block sits in the source, for readers that fill blocks out of order
+
+            [[nodiscard]] std::string_view view() const {
+                return {data, size};
+            }
+        };
+
+        BlockPool(std::size_t block_count, std::size_t block_size, std::size_t alignment = alignof(std::max_align_t))
+            : storage_(std::make_unique_for_overwrite<char[]>(block_count * block_size + alignment))
+            , blocks_(block_count)
+            , block_size_(block_size) {
+            void*       first = storage_.get();
+            std::size_t space = block_count * block_size + alignment;
+            first             = std::align(alignment, block_count * block_size, first, space);
+
+            for (std::size_t i = 0; i != block_count; ++i) {
+                blocks_[i].data = static_cast<char*>(first) + i * block_size;
+                free_.push_back(&blocks_[i]);
+            }
+        }
+
+        [[nodiscard]] std::size_t block_size() const {
+            return block_size_;
+        }
+
+        // Reader side: waits until a parser gives a block back.
+        [[nodiscard]] Block* acquire_free() {
+            std::unique_lock lock(mutex_);
+            free_available_.wait(lock, [this] { return !free_.empty(); });
+
+            Block* block = free_.front();
+            free_.pop_front();
+            return block;
+        }
+
+        void publish(Block* block) {
+            {
+                std::lock_guard lock(mutex_);
+                filled_.push_back(block);
+            }
+            filled_available_.notify_one();
+        }
+
+        // No block is published after this; parsers drain what is left and stop.
+        void close() {
+            {
+                std::lock_guard lock(mutex_);
+                closed_ = true;
+            }
+            filled_available_.notify_all();
+        }
+
+        // Parser side: the next filled block, or null once the pool is closed and drained.
+        [[nodiscard]] Block* acquire_filled() {
+            std::unique_lock lock(mutex_);
+            filled_available_.wait(lock, [this] { return !filled_.empty() || closed_; });
+            if (filled_.empty()) {
+                return nullptr;
+            }
+
+            Block* block = filled_.front();
+            filled_.pop_front();
+            return block;
+        }
+
+        void release(Block* block) {
+            {
+                std::lock_guard lock(mutex_);
+                free_.push_back(block);
+            }
+            free_available_.notify_one();
+        }
+
+    private:
+        std::unique_ptr<char[]> storage_;
+        std::vector<Block>      blocks_;
+        std::size_t             block_size_;
+        std::mutex              mutex_;
+        std::condition_variable free_available_;
+        std::condition_variable filled_available_;
+        std::deque<Block*>      free_;
+        std::deque<Block*>      filled_;
+        bool                    closed_ = false;
+    };
+
+    // Fills blocks from `source` until it ends. A block is cut after its last line break and the partial record behind it
+    // is moved to the front of the next block, so every published block holds whole records. Returns false if the source
+    // failed or a record does not fit a block.
+    [[nodiscard]] inline bool read_blocks(std::istream& source, BlockPool& pool, RunStats* stats) {
+        std::string carry;
+        while (true) {
+            BlockPool::Block* block = pool.acquire_free();
+            std::copy(carry.begin(), carry.end(), block->data);
+
+            const auto room = static_cast<std::streamsize>(pool.block_size() - carry.size());
+            source.read(block->data + carry.size(), room);
+            const auto filled = carry.size() + static_cast<std::size_t>(source.gcount());
+            if (source.bad()) {
+                pool.release(block);
+                return false;
+            }
+
+            const bool at_end = source.eof();
+            if (at_end) {
+                // the last record may lack its line break, which the parser copes with
+                block->size = filled;
+                carry.clear();
+            } else {
+                const std::string_view data(block->data, filled);
+                const auto             line_break = data.rfind('\n');
+                if (line_break == std::string_view::npos) {
+                    pool.release(block);
+                    return false;
+                }
+                block->size = line_break + 1;
+                carry.assign(data.substr(line_break + 1));
+            }
+
+            if (block->size == 0) {
+                pool.release(block);
+            } else {
+                if (STATS_SUPPORTED && stats != nullptr) {
+                    stats->segment_sizes.push_back(block->size);
+                }
+                pool.publish(block);
+            }
+
+            if (at_end) {
+                return true;
+            }
+        }
+    }
+
+    constexpr std::size_t STREAM_SPARE_BLOCKS = 2;  // beyond one per parser: the block being read and one ready to go
+
+    // Aggregates a stream that can be neither mapped nor seeked, e.g. stdin or a FIFO. One thread reads blocks of
+    // `block_size` bytes while `cpu_count` parsers aggregate the blocks already read, so memory stays at
+    // `(cpu_count + STREAM_SPARE_BLOCKS) * block_size` however long the stream is. Empty if the stream fails to read or
+    // holds a line longer than a block.
+    [[nodiscard]] inline std::optional<Registry> process_stream(
+        std::istream& source, std::size_t cpu_count, std::size_t block_size, RunStats* stats = nullptr
+    ) {
+        cpu_count = std::max<std::size_t>(cpu_count, 1);
+
+        BlockPool         pool(cpu_count + STREAM_SPARE_BLOCKS, block_size);
+        StationDictionary dictionary;
+
+        bool        read_ok = false;
+        std::thread reader([&] {
+            read_ok = read_blocks(source, pool, stats);
+            pool.close();
+        });
+
+        const auto worker = [&](DenseTable& table, WorkerStats* worker_stats) {
+            while (BlockPool::Block* block = pool.acquire_filled()) {
+                if (STATS_SUPPORTED && worker_stats != nullptr) {
+                    process_chunk(block->view(), table, *worker_stats);
+                } else {
+                    process_chunk(block->view(), table);
+                }
+                pool.release(block);
+            }
+        };
+        const auto table = run_workers(cpu_count, [&] { return DenseTable(dictionary); }, worker, stats);
+        reader.join();
+
+        if (!read_ok) {
+            return std::nullopt;
+        }
+        if (STATS_SUPPORTED && stats != nullptr) {
+            stats->dictionary.emplace().record(dictionary);
+        }
+        return table.to_registry();
+    }
+}  // namespace brc
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+    #include <sched.h>
+
+    #define BRC_HAS_AFFINITY 1
+#endif
+
+
+namespace brc {
+#if defined(BRC_HAS_AFFINITY)
+    constexpr bool AFFINITY_SUPPORTED = true;
+#else
+    constexpr bool AFFINITY_SUPPORTED = false;
+#endif
+
+    // CPUs grouped by NUMA node, restricted to the CPUs the process may run on.
+    struct CpuTopology {
+        std::vector<std::vector<unsigned>> nodes;
+
+        [[nodiscard]] std::size_t cpu_count() const {
+            std::size_t count = 0;
+            for (const auto& cpus : nodes) {
+                count += cpus.size();
+            }
+            return count;
+        }
+    };
+
+    // Parses a kernel CPU list such as `0-3,8-11`; node lists have the same format.
+    [[nodiscard]] inline std::vector<unsigned> parse_cpu_list(std::string_view list) {
+        std::vector<unsigned> cpus;
+        while (!list.empty()) {
+            const auto comma = list.find(',');
+            const auto range = list.substr(0, comma);
+            list             = (comma == std::string_view::npos) ? std::string_view{} : list.substr(comma + 1);
+
+            const auto dash  = range.find('-');
+            const auto first = static_cast<unsigned>(std::stoul(std::string(range.substr(0, dash))));
+            const auto last  = (dash == std::string_view::npos)
+                                 ? first
+                                 : static_cast<unsigned>(std::stoul(std::string(range.substr(dash + 1))));
+            for (auto cpu = first; cpu <= last; ++cpu) {
+                cpus.push_back(cpu);
+            }
+        }
+        return cpus;
+    }
+
+    // Reads the nodes from sysfs. Node ids need not be contiguous, e.g. once a node is offlined, so the online nodes are
+    // taken from the node list rather than counted up to the first gap. Without NUMA information, or off Linux, every CPU
+    // is put on a single node.
+    [[nodiscard]] inline CpuTopology read_cpu_topology() {
+        std::vector<unsigned> allowed;
+#if defined(BRC_HAS_AFFINITY)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (::sched_getaffinity(0, sizeof(set), &set) == 0) {
+            for (unsigned cpu = 0; cpu != CPU_SETSIZE; ++cpu) {
+                if (CPU_ISSET(cpu, &set)) {
+                    allowed.push_back(cpu);
+                }
+            }
+        }
+#endif
+        if (allowed.empty()) {
+            for (unsigned cpu = 0; cpu != std::max(std::thread::hardware_concurrency(), 1u); ++cpu) {
+                allowed.push_back(cpu);
+            }
+        }
+
+        CpuTopology                 topology;
+        const std::filesystem::path root = "/sys/devices/system/node";
+
+        std::string node_list;
+        for (const auto* name : {"online", "possible"}) {
+            std::ifstream file(root / name);
+            if (std::getline(file, node_list)) {
+                break;
+            }
+        }
+
+        for (const auto node : parse_cpu_list(node_list)) {
+            std::ifstream file(root / ("node" + std::to_string(node)) / "cpulist");
+            std::string   list;
+            if (!std::getline(file, list)) {
+                continue;
+            }
+
+            std::vector<unsigned> cpus;
+            for (const auto cpu : parse_cpu_list(list)) {
+                if (std::find(allowed.begin(), allowed.end(), cpu) != allowed.end()) {
+                    cpus.push_back(cpu);
+                }
+            }
+            if (!cpus.empty()) {
+                topology.nodes.push_back(std::move(cpus));
+            }
+        }
+
+        if (topology.nodes.empty()) {
+            topology.nodes.push_back(std::move(allowed));
+        }
+        return topology;
+    }
+
+    // Where each worker runs: its CPU, if pinned, and the node whose share of the source it reads first and whose
+    // partial results it is merged with first.
+    struct Placement {
+        std::vector<std::optional<unsigned>> cpus;
+        std::vector<std::size_t>             nodes;
+        std::size_t                          node_count = 1;
+    };
+
+    // Spreads `worker_count` workers evenly over the CPUs of `topology`, node by node, so every node gets a share in
+    // proportion to its CPUs and consecutive workers share a node. Unless `numa` is set the nodes are ignored and all
+    // workers count as one node.
+    [[nodiscard]] inline Placement make_placement(const CpuTopology& topology, std::size_t worker_count, bool numa) {
+        std::vector<std::pair<unsigned, std::size_t>> cpus;  // the CPU and its node, in node order
+        for (std::size_t node = 0; node != topology.nodes.size(); ++node) {
+            for (const auto cpu : topology.nodes[node]) {
+                cpus.emplace_back(cpu, node);
+            }
+        }
+
+        Placement placement;
+        placement.node_count = numa ? topology.nodes.size() : 1;
+        for (std::size_t i = 0; i != worker_count; ++i) {
+            const auto& [cpu, node] = cpus[i * cpus.size() / worker_count];
+            placement.cpus.emplace_back(cpu);
+            placement.nodes.push_back(numa ? node : 0);
+        }
+        return placement;
+    }
+
+    // Restricts the calling thread to `cpu`. Memory the thread touches first afterwards is then allocated on its node
+    // under the default policy. Returns false if the CPU cannot be used.
+    inline bool pin_current_thread([[maybe_unused]] unsigned cpu) {
+#if defined(BRC_HAS_AFFINITY)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        return ::sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+        return false;
+#endif
+    }
+}  // namespace brc
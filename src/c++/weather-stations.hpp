@@ -0,0 +1,430 @@
+#pragma once
+
+#include <array>
+#include <string_view>
+
+
+namespace brc {
+    // Stations of the challenge with their mean temperatures. The generator draws measurements from this list and the
+    // aggregator builds a perfect hash over it at compile time, so both sides agree on the known station set.
+    struct KnownStation {
+        std::string_view name;
+        float            mean_temperature;
+    };
+
+    inline constexpr std::array KNOWN_STATIONS = std::to_array<KnownStation>({
+        {"Abha", 18.0f},
+        {"Abidjan", 26.0f},
+        {"Abéché", 29.4f},
+        {"Accra", 26.4f},
+        {"Addis Ababa", 16.0f},
+        {"Adelaide", 17.3f},
+        {"Aden", 29.1f},
+        {"Ahvaz", 25.4f},
+        {"Albuquerque", 14.0f},
+        {"Alexandra", 11.0f},
+        {"Alexandria", 20.0f},
+        {"Algiers", 18.2f},
+        {"Alice Springs", 21.0f},
+        {"Almaty", 10.0f},
+        {"Amsterdam", 10.2f},
+        {"Anadyr", -6.9f},
+        {"Anchorage", 2.8f},
+        {"Andorra la Vella", 9.8f},
+        {"Ankara", 12.0f},
+        {"Antananarivo", 17.9f},
+        {"Antsiranana", 25.2f},
+        {"Arkhangelsk", 1.3f},
+        {"Ashgabat", 17.1f},
+        {"Asmara", 15.6f},
+        {"Assab", 30.5f},
+        {"Astana", 3.5f},
+        {"Athens", 19.2f},
+        {"Atlanta", 17.0f},
+        {"Auckland", 15.2f},
+        {"Austin", 20.7f},
+        {"Baghdad", 22.77f},
+        {"Baguio", 19.5f},
+        {"Baku", 15.1f},
+        {"Baltimore", 13.1f},
+        {"Bamako", 27.8f},
+        {"Bangkok", 28.6f},
+        {"Bangui", 26.0f},
+        {"Banjul", 26.0f},
+        {"Barcelona", 18.2f},
+        {"Bata", 25.1f},
+        {"Batumi", 14.0f},
+        {"Beijing", 12.9f},
+        {"Beirut", 20.9f},
+        {"Belgrade", 12.5f},
+        {"Belize City", 26.7f},
+        {"Benghazi", 19.9f},
+        {"Bergen", 7.7f},
+        {"Berlin", 10.3f},
+        {"Bilbao", 14.7f},
+        {"Birao", 26.5f},
+        {"Bishkek", 11.3f},
+        {"Bissau", 27.0f},
+        {"Blantyre", 22.2f},
+        {"Bloemfontein", 15.6f},
+        {"Boise", 11.4f},
+        {"Bordeaux", 14.2f},
+        {"Bosaso", 30.0f},
+        {"Boston", 10.9f},
+        {"Bouaké", 26.0f},
+        {"Bratislava", 10.5f},
+        {"Brazzaville", 25.0f},
+        {"Bridgetown", 27.0f},
+        {"Brisbane", 21.4f},
+        {"Brussels", 10.5f},
+        {"Bucharest", 10.8f},
+        {"Budapest", 11.3f},
+        {"Bujumbura", 23.8f},
+        {"Bulawayo", 18.9f},
+        {"Burnie", 13.1f},
+        {"Busan", 15.0f},
+        {"Cabo San Lucas", 23.9f},
+        {"Cairns", 25.0f},
+        {"Cairo", 21.4f},
+        {"Calgary", 4.4f},
+        {"Canberra", 13.1f},
+        {"Cape Town", 16.2f},
+        {"Changsha", 17.4f},
+        {"Charlotte", 16.1f},
+        {"Chiang Mai", 25.8f},
+        {"Chicago", 9.8f},
+        {"Chihuahua", 18.6f},
+        {"Chișinău", 10.2f},
+        {"Chittagong", 25.9f},
+        {"Chongqing", 18.6f},
+        {"Christchurch", 12.2f},
+        {"City of San Marino", 11.8f},
+        {"Colombo", 27.4f},
+        {"Columbus", 11.7f},
+        {"Conakry", 26.4f},
+        {"Copenhagen", 9.1f},
+        {"Cotonou", 27.2f},
+        {"Cracow", 9.3f},
+        {"Da Lat", 17.9f},
+        {"Da Nang", 25.8f},
+        {"Dakar", 24.0f},
+        {"Dallas", 19.0f},
+        {"Damascus", 17.0f},
+        {"Dampier", 26.4f},
+        {"Dar es Salaam", 25.8f},
+        {"Darwin", 27.6f},
+        {"Denpasar", 23.7f},
+        {"Denver", 10.4f},
+        {"Detroit", 10.0f},
+        {"Dhaka", 25.9f},
+        {"Dikson", -11.1f},
+        {"Dili", 26.6f},
+        {"Djibouti", 29.9f},
+        {"Dodoma", 22.7f},
+        {"Dolisie", 24.0f},
+        {"Douala", 26.7f},
+        {"Dubai", 26.9f},
+        {"Dublin", 9.8f},
+        {"Dunedin", 11.1f},
+        {"Durban", 20.6f},
+        {"Dushanbe", 14.7f},
+        {"Edinburgh", 9.3f},
+        {"Edmonton", 4.2f},
+        {"El Paso", 18.1f},
+        {"Entebbe", 21.0f},
+        {"Erbil", 19.5f},
+        {"Erzurum", 5.1f},
+        {"Fairbanks", -2.3f},
+        {"Fianarantsoa", 17.9f},
+        {"Flores,  Petén", 26.4f},
+        {"Frankfurt", 10.6f},
+        {"Fresno", 17.9f},
+        {"Fukuoka", 17.0f},
+        {"Gabès", 19.5f},
+        {"Gaborone", 21.0f},
+        {"Gagnoa", 26.0f},
+        {"Gangtok", 15.2f},
+        {"Garissa", 29.3f},
+        {"Garoua", 28.3f},
+        {"George Town", 27.9f},
+        {"Ghanzi", 21.4f},
+        {"Gjoa Haven", -14.4f},
+        {"Guadalajara", 20.9f},
+        {"Guangzhou", 22.4f},
+        {"Guatemala City", 20.4f},
+        {"Halifax", 7.5f},
+        {"Hamburg", 9.7f},
+        {"Hamilton", 13.8f},
+        {"Hanga Roa", 20.5f},
+        {"Hanoi", 23.6f},
+        {"Harare", 18.4f},
+        {"Harbin", 5.0f},
+        {"Hargeisa", 21.7f},
+        {"Hat Yai", 27.0f},
+        {"Havana", 25.2f},
+        {"Helsinki", 5.9f},
+        {"Heraklion", 18.9f},
+        {"Hiroshima", 16.3f},
+        {"Ho Chi Minh City", 27.4f},
+        {"Hobart", 12.7f},
+        {"Hong Kong", 23.3f},
+        {"Honiara", 26.5f},
+        {"Honolulu", 25.4f},
+        {"Houston", 20.8f},
+        {"Ifrane", 11.4f},
+        {"Indianapolis", 11.8f},
+        {"Iqaluit", -9.3f},
+        {"Irkutsk", 1.0f},
+        {"Istanbul", 13.9f},
+        {"İzmir", 17.9f},
+        {"Jacksonville", 20.3f},
+        {"Jakarta", 26.7f},
+        {"Jayapura", 27.0f},
+        {"Jerusalem", 18.3f},
+        {"Johannesburg", 15.5f},
+        {"Jos", 22.8f},
+        {"Juba", 27.8f},
+        {"Kabul", 12.1f},
+        {"Kampala", 20.0f},
+        {"Kandi", 27.7f},
+        {"Kankan", 26.5f},
+        {"Kano", 26.4f},
+        {"Kansas City", 12.5f},
+        {"Karachi", 26.0f},
+        {"Karonga", 24.4f},
+        {"Kathmandu", 18.3f},
+        {"Khartoum", 29.9f},
+        {"Kingston", 27.4f},
+        {"Kinshasa", 25.3f},
+        {"Kolkata", 26.7f},
+        {"Kuala Lumpur", 27.3f},
+        {"Kumasi", 26.0f},
+        {"Kunming", 15.7f},
+        {"Kuopio", 3.4f},
+        {"Kuwait City", 25.7f},
+        {"Kyiv", 8.4f},
+        {"Kyoto", 15.8f},
+        {"La Ceiba", 26.2f},
+        {"La Paz", 23.7f},
+        {"Lagos", 26.8f},
+        {"Lahore", 24.3f},
+        {"Lake Havasu City", 23.7f},
+        {"Lake Tekapo", 8.7f},
+        {"Las Palmas de Gran Canaria", 21.2f},
+        {"Las Vegas", 20.3f},
+        {"Launceston", 13.1f},
+        {"Lhasa", 7.6f},
+        {"Libreville", 25.9f},
+        {"Lisbon", 17.5f},
+        {"Livingstone", 21.8f},
+        {"Ljubljana", 10.9f},
+        {"Lodwar", 29.3f},
+        {"Lomé", 26.9f},
+        {"London", 11.3f},
+        {"Los Angeles", 18.6f},
+        {"Louisville", 13.9f},
+        {"Luanda", 25.8f},
+        {"Lubumbashi", 20.8f},
+        {"Lusaka", 19.9f},
+        {"Luxembourg City", 9.3f},
+        {"Lviv", 7.8f},
+        {"Lyon", 12.5f},
+        {"Madrid", 15.0f},
+        {"Mahajanga", 26.3f},
+        {"Makassar", 26.7f},
+        {"Makurdi", 26.0f},
+        {"Malabo", 26.3f},
+        {"Malé", 28.0f},
+        {"Managua", 27.3f},
+        {"Manama", 26.5f},
+        {"Mandalay", 28.0f},
+        {"Mango", 28.1f},
+        {"Manila", 28.4f},
+        {"Maputo", 22.8f},
+        {"Marrakesh", 19.6f},
+        {"Marseille", 15.8f},
+        {"Maun", 22.4f},
+        {"Medan", 26.5f},
+        {"Mek'ele", 22.7f},
+        {"Melbourne", 15.1f},
+        {"Memphis", 17.2f},
+        {"Mexicali", 23.1f},
+        {"Mexico City", 17.5f},
+        {"Miami", 24.9f},
+        {"Milan", 13.0f},
+        {"Milwaukee", 8.9f},
+        {"Minneapolis", 7.8f},
+        {"Minsk", 6.7f},
+        {"Mogadishu", 27.1f},
+        {"Mombasa", 26.3f},
+        {"Monaco", 16.4f},
+        {"Moncton", 6.1f},
+        {"Monterrey", 22.3f},
+        {"Montreal", 6.8f},
+        {"Moscow", 5.8f},
+        {"Mumbai", 27.1f},
+        {"Murmansk", 0.6f},
+        {"Muscat", 28.0f},
+        {"Mzuzu", 17.7f},
+        {"N'Djamena", 28.3f},
+        {"Naha", 23.1f},
+        {"Nairobi", 17.8f},
+        {"Nakhon Ratchasima", 27.3f},
+        {"Napier", 14.6f},
+        {"Napoli", 15.9f},
+        {"Nashville", 15.4f},
+        {"Nassau", 24.6f},
+        {"Ndola", 20.3f},
+        {"New Delhi", 25.0f},
+        {"New Orleans", 20.7f},
+        {"New York City", 12.9f},
+        {"Ngaoundéré", 22.0f},
+        {"Niamey", 29.3f},
+        {"Nicosia", 19.7f},
+        {"Niigata", 13.9f},
+        {"Nouadhibou", 21.3f},
+        {"Nouakchott", 25.7f},
+        {"Novosibirsk", 1.7f},
+        {"Nuuk", -1.4f},
+        {"Odesa", 10.7f},
+        {"Odienné", 26.0f},
+        {"Oklahoma City", 15.9f},
+        {"Omaha", 10.6f},
+        {"Oranjestad", 28.1f},
+        {"Oslo", 5.7f},
+        {"Ottawa", 6.6f},
+        {"Ouagadougou", 28.3f},
+        {"Ouahigouya", 28.6f},
+        {"Ouarzazate", 18.9f},
+        {"Oulu", 2.7f},
+        {"Palembang", 27.3f},
+        {"Palermo", 18.5f},
+        {"Palm Springs", 24.5f},
+        {"Palmerston North", 13.2f},
+        {"Panama City", 28.0f},
+        {"Parakou", 26.8f},
+        {"Paris", 12.3f},
+        {"Perth", 18.7f},
+        {"Petropavlovsk-Kamchatsky", 1.9f},
+        {"Philadelphia", 13.2f},
+        {"Phnom Penh", 28.3f},
+        {"Phoenix", 23.9f},
+        {"Pittsburgh", 10.8f},
+        {"Podgorica", 15.3f},
+        {"Pointe-Noire", 26.1f},
+        {"Pontianak", 27.7f},
+        {"Port Moresby", 26.9f},
+        {"Port Sudan", 28.4f},
+        {"Port Vila", 24.3f},
+        {"Port-Gentil", 26.0f},
+        {"Portland (OR)", 12.4f},
+        {"Porto", 15.7f},
+        {"Prague", 8.4f},
+        {"Praia", 24.4f},
+        {"Pretoria", 18.2f},
+        {"Pyongyang", 10.8f},
+        {"Rabat", 17.2f},
+        {"Rangpur", 24.4f},
+        {"Reggane", 28.3f},
+        {"Reykjavík", 4.3f},
+        {"Riga", 6.2f},
+        {"Riyadh", 26.0f},
+        {"Rome", 15.2f},
+        {"Roseau", 26.2f},
+        {"Rostov-on-Don", 9.9f},
+        {"Sacramento", 16.3f},
+        {"Saint Petersburg", 5.8f},
+        {"Saint-Pierre", 5.7f},
+        {"Salt Lake City", 11.6f},
+        {"San Antonio", 20.8f},
+        {"San Diego", 17.8f},
+        {"San Francisco", 14.6f},
+        {"San Jose", 16.4f},
+        {"San José", 22.6f},
+        {"San Juan", 27.2f},
+        {"San Salvador", 23.1f},
+        {"Sana'a", 20.0f},
+        {"Santo Domingo", 25.9f},
+        {"Sapporo", 8.9f},
+        {"Sarajevo", 10.1f},
+        {"Saskatoon", 3.3f},
+        {"Seattle", 11.3f},
+        {"Ségou", 28.0f},
+        {"Seoul", 12.5f},
+        {"Seville", 19.2f},
+        {"Shanghai", 16.7f},
+        {"Singapore", 27.0f},
+        {"Skopje", 12.4f},
+        {"Sochi", 14.2f},
+        {"Sofia", 10.6f},
+        {"Sokoto", 28.0f},
+        {"Split", 16.1f},
+        {"St. John's", 5.0f},
+        {"St. Louis", 13.9f},
+        {"Stockholm", 6.6f},
+        {"Surabaya", 27.1f},
+        {"Suva", 25.6f},
+        {"Suwałki", 7.2f},
+        {"Sydney", 17.7f},
+        {"Tabora", 23.0f},
+        {"Tabriz", 12.6f},
+        {"Taipei", 23.0f},
+        {"Tallinn", 6.4f},
+        {"Tamale", 27.9f},
+        {"Tamanrasset", 21.7f},
+        {"Tampa", 22.9f},
+        {"Tashkent", 14.8f},
+        {"Tauranga", 14.8f},
+        {"Tbilisi", 12.9f},
+        {"Tegucigalpa", 21.7f},
+        {"Tehran", 17.0f},
+        {"Tel Aviv", 20.0f},
+        {"Thessaloniki", 16.0f},
+        {"Thiès", 24.0f},
+        {"Tijuana", 17.8f},
+        {"Timbuktu", 28.0f},
+        {"Tirana", 15.2f},
+        {"Toamasina", 23.4f},
+        {"Tokyo", 15.4f},
+        {"Toliara", 24.1f},
+        {"Toluca", 12.4f},
+        {"Toronto", 9.4f},
+        {"Tripoli", 20.0f},
+        {"Tromsø", 2.9f},
+        {"Tucson", 20.9f},
+        {"Tunis", 18.4f},
+        {"Ulaanbaatar", -0.4f},
+        {"Upington", 20.4f},
+        {"Ürümqi", 7.4f},
+        {"Vaduz", 10.1f},
+        {"Valencia", 18.3f},
+        {"Valletta", 18.8f},
+        {"Vancouver", 10.4f},
+        {"Veracruz", 25.4f},
+        {"Vienna", 10.4f},
+        {"Vientiane", 25.9f},
+        {"Villahermosa", 27.1f},
+        {"Vilnius", 6.0f},
+        {"Virginia Beach", 15.8f},
+        {"Vladivostok", 4.9f},
+        {"Warsaw", 8.5f},
+        {"Washington, D.C.", 14.6f},
+        {"Wau", 27.8f},
+        {"Wellington", 12.9f},
+        {"Whitehorse", -0.1f},
+        {"Wichita", 13.9f},
+        {"Willemstad", 28.0f},
+        {"Winnipeg", 3.0f},
+        {"Wrocław", 9.6f},
+        {"Xi'an", 14.1f},
+        {"Yakutsk", -8.8f},
+        {"Yangon", 27.5f},
+        {"Yaoundé", 23.8f},
+        {"Yellowknife", -4.3f},
+        {"Yerevan", 12.4f},
+        {"Yinchuan", 9.0f},
+        {"Zagreb", 10.7f},
+        {"Zanzibar City", 26.0f},
+        {"Zürich", 9.3f},
+    });
+}  // namespace brc
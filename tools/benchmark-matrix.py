@@ -0,0 +1,292 @@
+#!/usr/bin/env python3
+from dataclasses import asdict
+from dataclasses import dataclass
+from datetime import datetime
+from itertools import product
+from json import dumps
+from json import loads
+from os import cpu_count
+from os import waitstatus_to_exitcode
+from pathlib import Path
+from platform import node
+from statistics import median
+from subprocess import DEVNULL
+from subprocess import Popen
+from subprocess import run
+from sys import exit
+from sys import platform
+from time import perf_counter
+
+from click import Choice
+from click import command
+from click import echo
+from click import option
+
+DEFAULT_ROWS = (10_000_000, 100_000_000, 1_000_000_000)
+DEFAULT_STATIONS = (413, 10_000)
+BUILT_IN_STATIONS = 413
+DROP_CACHES = Path("/proc/sys/vm/drop_caches")
+
+
+@dataclass(slots=True, frozen=True)
+class Dataset:
+    rows: int
+    stations: int
+    long_names: bool
+
+    @property
+    def name(self) -> str:
+        names = "long-utf8" if self.long_names else "short"
+        return f"rows-{self.rows}_stations-{self.stations}_{names}-names"
+
+    def generator_arguments(self) -> list[str]:
+        """Return the `create-measurements` options: the built-in list when it fits, UTF-8 for long names."""
+        if self.stations == BUILT_IN_STATIONS and not self.long_names:
+            return []
+
+        long_names = ["--long-names", "--utf8-names"] if self.long_names else []
+        return ["--stations", str(self.stations), *long_names]
+
+
+@dataclass(slots=True)
+class Result:
+    dataset: str
+    cache: str
+    pool_size: int
+    seconds: float
+    rows_per_second: float
+    gigabytes_per_second: float
+    peak_rss_mb: float | None
+    scaling_efficiency: float = 1.0
+
+    @property
+    def key(self) -> tuple[str, str, int]:
+        return self.dataset, self.cache, self.pool_size
+
+
+def executable(build_dir: Path, name: str) -> Path:
+    for candidate in (build_dir / name, build_dir / f"{name}.exe"):
+        if candidate.is_file():
+            return candidate
+
+    echo(f"{name} is missing in {build_dir}", err=True)
+    exit(1)
+
+
+def prepare_dataset(generator: Path, data_dir: Path, dataset: Dataset, seed: int) -> Path:
+    """Generate the dataset once; the seed makes every machine produce the same file."""
+    path = data_dir / f"{dataset.name}_seed-{seed}.txt"
+    if path.is_file():
+        return path
+
+    echo(f"Generating {path.name}")
+    partial = path.with_suffix(".partial")
+    arguments = [str(generator), str(partial), "--records", str(dataset.rows), "--seed", str(seed)]
+    run(arguments + dataset.generator_arguments(), check=True, stdout=DEVNULL)
+    partial.replace(path)
+    return path
+
+
+def drop_page_cache() -> bool:
+    """Evict the page cache, which takes root on Linux; return whether it worked."""
+    try:
+        from os import sync  # POSIX only
+
+        sync()
+        DROP_CACHES.write_text("3\n")
+        return True
+    except (ImportError, OSError):
+        return False
+
+
+def run_once(aggregator: Path, source: Path, pool_size: int) -> tuple[float, float | None]:
+    """Return the wall time of one run and its peak RSS in MiB when the platform reports it."""
+    start_point = perf_counter()
+    process = Popen([str(aggregator), str(source), "--pool-size", str(pool_size)], stdout=DEVNULL)
+    try:
+        from os import wait4
+    except ImportError:  # Windows
+        status = process.wait()
+        peak_rss = None
+    else:
+        _, wait_status, usage = wait4(process.pid, 0)
+        # a negative exit code is the signal that stopped the aggregator, as with `Popen.wait`
+        status = waitstatus_to_exitcode(wait_status)
+        process.returncode = status
+        # `ru_maxrss` is in KiB on Linux and in bytes on macOS
+        peak_rss = usage.ru_maxrss / (1024 * 1024 if platform == "darwin" else 1024)
+    seconds = perf_counter() - start_point
+
+    if status != 0:
+        echo(f"{aggregator.name} failed on {source.name} with status {status}", err=True)
+        exit(1)
+
+    return seconds, peak_rss
+
+
+def measure(aggregator: Path, source: Path, dataset: Dataset, cache: str, pool_size: int, repetitions: int) -> Result:
+    timings: list[float] = []
+    peaks: list[float] = []
+    if cache == "warm":
+        run_once(aggregator, source, pool_size)
+
+    for _ in range(repetitions):
+        if cache == "cold":
+            drop_page_cache()
+        seconds, peak_rss = run_once(aggregator, source, pool_size)
+        timings.append(seconds)
+        if peak_rss is not None:
+            peaks.append(peak_rss)
+
+    seconds = median(timings)
+    return Result(
+        dataset=dataset.name,
+        cache=cache,
+        pool_size=pool_size,
+        seconds=seconds,
+        rows_per_second=dataset.rows / seconds,
+        gigabytes_per_second=source.stat().st_size / seconds / 1e9,
+        peak_rss_mb=max(peaks) if peaks else None,
+    )
+
+
+def fill_scaling_efficiency(results: list[Result]) -> None:
+    """Relate every run to the smallest pool of its dataset and cache: 1.0 is linear scaling."""
+    baselines: dict[tuple[str, str], Result] = {}
+    for result in results:
+        baseline = baselines.get((result.dataset, result.cache))
+        if baseline is None or result.pool_size < baseline.pool_size:
+            baselines[(result.dataset, result.cache)] = result
+
+    for result in results:
+        baseline = baselines[(result.dataset, result.cache)]
+        speedup = baseline.seconds / result.seconds
+        result.scaling_efficiency = speedup * baseline.pool_size / result.pool_size
+
+
+def find_regressions(previous: list[dict[str, object]], results: list[Result], threshold: float) -> list[str]:
+    """Compare throughput with the matching runs of the previous entry."""
+    before = {(str(item["dataset"]), str(item["cache"]), int(str(item["pool_size"]))): item for item in previous}
+
+    regressions = []
+    for result in results:
+        if (item := before.get(result.key)) is None:
+            continue
+
+        previous_rate = float(str(item["rows_per_second"]))
+        change = (result.rows_per_second - previous_rate) / previous_rate * 100
+        if change < -threshold:
+            dataset, cache, pool_size = result.key
+            regressions.append(f"{dataset} {cache} cache, pool size {pool_size}: {change:+.1f}% rows/sec")
+
+    return regressions
+
+
+def previous_entry(entries: list[dict[str, object]], host: str, cpus: int | None) -> dict[str, object] | None:
+    """Return the latest entry recorded on the same host with the same CPU count; others are not comparable."""
+    for entry in reversed(entries):
+        if entry.get("host") == host and entry.get("cpu_count") == cpus:
+            return entry
+    return None
+
+
+def current_commit() -> str | None:
+    completed = run(["git", "rev-parse", "--short", "HEAD"], capture_output=True, text=True)
+    return completed.stdout.strip() if completed.returncode == 0 else None
+
+
+def print_results(results: list[Result]) -> None:
+    echo(
+        f"{'dataset':<48} {'cache':<5} {'pool':>4} {'seconds':>9} {'Mrows/s':>9} {'GB/s':>6} {'RSS MiB':>8} {'eff':>5}"
+    )
+    for result in results:
+        rss = f"{result.peak_rss_mb:.0f}" if result.peak_rss_mb is not None else "-"
+        echo(
+            f"{result.dataset:<48} {result.cache:<5} {result.pool_size:>4} {result.seconds:>9.3f} "
+            f"{result.rows_per_second / 1e6:>9.1f} {result.gigabytes_per_second:>6.2f} {rss:>8} "
+            f"{result.scaling_efficiency:>5.2f}"
+        )
+
+
+def default_pool_sizes() -> tuple[int, ...]:
+    cpus = cpu_count() or 1
+    sizes = [1]
+    while sizes[-1] * 2 < cpus:
+        sizes.append(sizes[-1] * 2)
+    return tuple(sizes + [cpus] if cpus > 1 else sizes)
+
+
+@command("benchmark-matrix", options_metavar="")
+@option("--build-dir", type=Path, required=True, help="Directory with the built C++ executables")
+@option("--data-dir", type=Path, default=Path("benchmark-data"), help="Where datasets are cached", show_default=True)
+@option("--history", type=Path, default=Path("benchmark-history.json"), help="JSON history file", show_default=True)
+@option("--rows", type=int, multiple=True, default=DEFAULT_ROWS, help="Dataset sizes", show_default=True)
+@option("--stations", type=int, multiple=True, default=DEFAULT_STATIONS, help="Station counts", show_default=True)
+@option("--pool-size", "pool_sizes", type=int, multiple=True, default=default_pool_sizes(), show_default=True)
+@option("--cache", "caches", type=Choice(["warm", "cold"]), multiple=True, default=("warm", "cold"), show_default=True)
+@option("--repetitions", default=3, type=int, help="Timed runs per cell; the median is kept", show_default=True)
+@option("--seed", default=1, type=int, help="Seed of the generated datasets", show_default=True)
+@option("--threshold", default=5.0, type=float, help="Regression threshold in percent", show_default=True)
+def main(
+    build_dir: Path,
+    data_dir: Path,
+    history: Path,
+    rows: tuple[int, ...],
+    stations: tuple[int, ...],
+    pool_sizes: tuple[int, ...],
+    caches: tuple[str, ...],
+    repetitions: int,
+    seed: int,
+    threshold: float,
+) -> None:
+    """
+    Run `billion-record-challenge` over a matrix of generated datasets (rows x stations x name lengths), pool sizes and
+    page cache states, append the results to a JSON history and compare them with the previous entry of the same host
+    and CPU count.
+
+    Exits with status 1 when the throughput of any cell dropped by more than the threshold. Cold cache runs need the
+    permission to write /proc/sys/vm/drop_caches and are skipped otherwise.
+    """
+    generator = executable(build_dir, "create-measurements")
+    aggregator = executable(build_dir, "billion-record-challenge")
+    data_dir.mkdir(parents=True, exist_ok=True)
+
+    if "cold" in caches and not drop_page_cache():
+        echo("Cannot drop the page cache (it takes root on Linux), cold cache runs are skipped", err=True)
+        caches = tuple(cache for cache in caches if cache != "cold")
+
+    results: list[Result] = []
+    for row_count, station_count, long_names in product(sorted(rows), sorted(stations), (False, True)):
+        dataset = Dataset(row_count, station_count, long_names)
+        source = prepare_dataset(generator, data_dir, dataset, seed)
+        for cache, pool_size in product(caches, sorted(pool_sizes)):
+            echo(f"Running {dataset.name}, {cache} cache, pool size {pool_size}")
+            results.append(measure(aggregator, source, dataset, cache, pool_size, repetitions))
+
+    fill_scaling_efficiency(results)
+    print_results(results)
+
+    entries = loads(history.read_text()) if history.is_file() else []
+    previous = previous_entry(entries, node(), cpu_count())
+    regressions = find_regressions(previous["results"], results, threshold) if previous is not None else []
+
+    entries.append(
+        {
+            "timestamp": datetime.now().isoformat(timespec="seconds"),
+            "commit": current_commit(),
+            "host": node(),
+            "cpu_count": cpu_count(),
+            "results": [asdict(result) for result in results],
+        }
+    )
+    history.write_text(dumps(entries, indent=4) + "\n")
+
+    if regressions:
+        echo(f"Regressions against the previous run (threshold {threshold}%):", err=True)
+        for regression in regressions:
+            echo(f"  {regression}", err=True)
+        exit(1)
+
+
+if __name__ == "__main__":
+    main()